@@ -0,0 +1,114 @@
+// Request-scoped allocations with and without an arena::Scope, per request:
+// a GET /books page (rows copied out under the lock, then serialized) and
+// the JSON a POST /books builds around the catalog change (the parsed body,
+// the "book" event and the reply).
+#include "bench.hpp"
+#include "catalog.hpp"
+#include "json_writer.hpp"
+#include "record_parser.hpp"
+#include "request_arena.hpp"
+
+namespace {
+
+// main.cpp's page row.
+struct PageBook {
+    int id;
+    arena::string title;
+    arena::string author;
+    bool isAvailable;
+};
+
+const Catalog& catalog() {
+    static Catalog books = [] {
+        Catalog c;
+        for (const Book& b : bench::makeBooks(100000)) c.push_back(b);
+        return c;
+    }();
+    return books;
+}
+
+// Before: the page as Books, serialized into a growing string.
+std::string pageWithBooks(size_t first, size_t limit) {
+    const Catalog& books = catalog();
+    std::vector<Book> page;
+    for (size_t slot = first; slot < first + limit; ++slot) page.push_back(books.row(slot).book());
+    std::string body = "{\"books\":[";
+    for (size_t i = 0; i < page.size(); ++i) {
+        if (i) body += ',';
+        jsonout::appendBook(body, page[i]);
+    }
+    body += "],\"nextCursor\":" + std::to_string(page.back().id) + "}";
+    return body;
+}
+
+// After: the page in the request's arena, into a body reserved up front.
+std::string pageInArena(size_t first, size_t limit) {
+    const Catalog& books = catalog();
+    arena::Scope scope;
+    arena::vector<PageBook> page;
+    for (size_t slot = first; slot < first + limit; ++slot)
+        page.push_back(PageBook{books.id(slot), arena::string(books.title(slot)), arena::string(books.author(slot)),
+                                books.isAvailable(slot)});
+    size_t bytes = 64;
+    for (const auto& b : page) bytes += b.title.size() + b.author.size() + 64;
+    std::string body;
+    body.reserve(bytes);
+    body += "{\"books\":[";
+    for (size_t i = 0; i < page.size(); ++i) {
+        if (i) body += ',';
+        jsonout::appendBook(body, page[i].id, page[i].title, page[i].author, page[i].isAvailable);
+    }
+    body += "],\"nextCursor\":" + std::to_string(page.back().id) + "}";
+    return body;
+}
+
+const std::string postBody =
+    R"({"id":123456,"title":"The northern orchard of distant letters","author":"Author harbor 4711","isAvailable":true})";
+
+// Before: a json tree for the body, the event and the reply.
+size_t postWithJson() {
+    json x = json::parse(postBody);
+    Book b{x.at("id").get<int>(), x.at("title").get<std::string>(), x.at("author").get<std::string>(),
+           x.value("isAvailable", true)};
+    std::string event = json{{"op", "saved"}, {"book", b.to_json()}}.dump();
+    std::string reply = json{{"success", true}}.dump();
+    return event.size() + reply.size();
+}
+
+// After: the SAX parser fills the Book; the event and reply come from the arena.
+size_t postInArena() {
+    arena::Scope scope;
+    Book b;
+    std::string error;
+    BookParser::parse(postBody, b, error);
+    std::string event = arena::dump(arena_json{{"op", "saved"}, {"book", b.to_json<arena_json>()}});
+    std::string reply = arena::dump(arena_json{{"success", true}});
+    return event.size() + reply.size();
+}
+
+}  // namespace
+
+BENCH(arena_get_books) {
+    catalog();
+    for (size_t limit : {100, 1000}) {
+        std::string label = "page of " + std::to_string(limit) + ", ";
+        size_t at = 0;
+        auto next = [&] { return (at += 7919) % (100000 - limit); };
+        bench::report(label + "Books: allocations/request",
+                      bench::allocationsPer([&] { pageWithBooks(next(), limit); }, 200));
+        bench::report(label + "arena: allocations/request",
+                      bench::allocationsPer([&] { pageInArena(next(), limit); }, 200));
+        bench::report(label + "Books: us/request",
+                      bench::timeMs([&] { for (int i = 0; i < 200; ++i) pageWithBooks(next(), limit); }) * 5);
+        bench::report(label + "arena: us/request",
+                      bench::timeMs([&] { for (int i = 0; i < 200; ++i) pageInArena(next(), limit); }) * 5);
+    }
+}
+
+BENCH(arena_post_books) {
+    bench::report("json tree: allocations/request", bench::allocationsPer(postWithJson, 10000));
+    bench::report("arena: allocations/request", bench::allocationsPer(postInArena, 10000));
+    bench::report("json tree: us/request",
+                  bench::timeMs([] { for (int i = 0; i < 10000; ++i) postWithJson(); }) / 10);
+    bench::report("arena: us/request", bench::timeMs([] { for (int i = 0; i < 10000; ++i) postInArena(); }) / 10);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "models.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// A small harness for the benchmarks in this directory. Each file defines
+// cases with BENCH(name) { ... }; library_bench runs every case whose name
+// contains its first argument (all of them without one), and each case
+// prints its measurements one per line. The old code paths they compare
+// against are reproduced in the case, as they stood before the change.
+namespace bench {
+
+struct Case {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> all;
+    return all;
+}
+
+struct Register {
+    Register(const char* name, void (*run)()) { cases().push_back({name, run}); }
+};
+
+// operator new calls so far, on every thread; counted by bench/main.cpp.
+uint64_t allocations();
+
+// Median wall time of reps calls of f, in milliseconds.
+template <typename F>
+double timeMs(F&& f, int reps = 5) {
+    std::vector<double> ms;
+    for (int r = 0; r < reps; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    return ms[ms.size() / 2];
+}
+
+// Average operator new calls per call of f, over calls calls.
+template <typename F>
+double allocationsPer(F&& f, int calls = 1000) {
+    uint64_t before = allocations();
+    for (int c = 0; c < calls; ++c) f();
+    return double(allocations() - before) / calls;
+}
+
+// The p-th percentile (0..100) of samples.
+inline double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0;
+    size_t at = static_cast<size_t>(p / 100 * double(samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(at), samples.end());
+    return samples[at];
+}
+
+inline void report(const std::string& what, double value) { std::printf("  %-52s %12.2f\n", what.c_str(), value); }
+
+// n books with ids 1..n, titles and authors longer than the small-string
+// buffer and authors shared by about 20 books each; the same every run.
+inline std::vector<Book> makeBooks(size_t n, unsigned seed = 1) {
+    static const char* words[] = {"river", "shadow", "garden", "winter", "silent", "empire", "glass", "northern",
+                                  "letters", "harbor", "crown", "distant", "orchard", "memory", "paper", "storm"};
+    std::mt19937 rng(seed);
+    std::vector<Book> books;
+    books.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        std::string title = "The";
+        for (int w = 0; w < 3; ++w) title += std::string(" ") + words[rng() % 16];
+        title += " " + std::to_string(i);
+        size_t a = rng() % (n / 20 + 1);
+        std::string author = std::string("Author ") + words[a % 16] + " " + std::to_string(a);
+        books.push_back(Book{static_cast<int>(i + 1), std::move(title), std::move(author), rng() % 4 != 0});
+    }
+    return books;
+}
+
+}  // namespace bench
+
+#define BENCH(name)                                                        \
+    static void bench_##name();                                            \
+    static const bench::Register bench_register_##name(#name, bench_##name); \
+    static void bench_##name()
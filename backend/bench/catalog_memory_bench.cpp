@@ -0,0 +1,49 @@
+// Resident memory per book for a 1M-book load: Catalog (interned authors,
+// one title arena) against the vector<Book> it replaced, each built by
+// appending one book at a time as the loaders do. Measured as the growth of
+// the process's resident set, with freed heap handed back in between, and
+// as heap allocations; Catalog::memory() is what GET /metrics reports.
+#include "bench.hpp"
+#include "catalog.hpp"
+#include <fstream>
+#include <malloc.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t kBooks = 1000000;
+
+size_t residentBytes() {
+    malloc_trim(0);
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+}  // namespace
+
+BENCH(catalog_memory) {
+    std::vector<Book> books = bench::makeBooks(kBooks);
+    double n = double(kBooks);
+
+    {
+        size_t before = residentBytes();
+        uint64_t allocations = bench::allocations();
+        std::vector<Book> copy;
+        for (const Book& b : books) copy.push_back(b);
+        bench::report("vector<Book>: resident bytes/book", double(residentBytes() - before) / n);
+        bench::report("vector<Book>: allocations/book", double(bench::allocations() - allocations) / n);
+    }
+    {
+        size_t before = residentBytes();
+        uint64_t allocations = bench::allocations();
+        Catalog catalog;
+        for (const Book& b : books) catalog.push_back(b);
+        bench::report("Catalog: resident bytes/book", double(residentBytes() - before) / n);
+        bench::report("Catalog: allocations/book", double(bench::allocations() - allocations) / n);
+        Catalog::Memory m = catalog.memory();
+        bench::report("Catalog::memory(): bytes/book", double(m.total()) / n);
+        bench::report("Catalog::memory(): distinct authors", double(m.authors));
+    }
+}
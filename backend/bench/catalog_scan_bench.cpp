@@ -0,0 +1,81 @@
+// Whole-catalog scans on 1M books, as the columns serve them (GET /metrics'
+// available count, the facet counts, pinning a copy for the GET /books body)
+// against the same loops over the vector<Book> the catalog replaced.
+#include "bench.hpp"
+#include "catalog.hpp"
+
+namespace {
+
+const size_t kBooks = 1000000;
+
+}  // namespace
+
+BENCH(catalog_scan) {
+    std::vector<Book> books = bench::makeBooks(kBooks);
+    Catalog catalog;
+    for (const Book& b : books) catalog.push_back(b);
+    auto check = [](const char* what, size_t a, size_t b) {
+        if (a != b) std::printf("  %s: %zu vs %zu\n", what, a, b);
+    };
+
+    {
+        size_t rows = 0, columns = 0;
+        double rowsMs = bench::timeMs([&] {
+            rows = 0;
+            for (const Book& b : books) rows += b.isAvailable;
+        });
+        double columnsMs = bench::timeMs([&] { columns = catalog.countAvailable(); });
+        check("available", rows, columns);
+        bench::report("count available: vector<Book> (ms)", rowsMs);
+        bench::report("count available: Catalog (ms)", columnsMs);
+    }
+    {
+        // Available books of one author, as a facet filter does.
+        const std::string& author = books[kBooks / 2].author;
+        uint32_t authorId = catalog.authorId(kBooks / 2);
+        size_t rows = 0, columns = 0;
+        double rowsMs = bench::timeMs([&] {
+            rows = 0;
+            for (const Book& b : books) rows += b.isAvailable && b.author == author;
+        });
+        double columnsMs = bench::timeMs([&] {
+            columns = 0;
+            for (size_t w = 0; w * 64 < catalog.size(); ++w)
+                for (uint64_t bits = catalog.availableWord(w); bits; bits &= bits - 1)
+                    columns += catalog.authorId(w * 64 + static_cast<size_t>(__builtin_ctzll(bits))) == authorId;
+        });
+        check("one author", rows, columns);
+        bench::report("one author's available books: vector<Book> (ms)", rowsMs);
+        bench::report("one author's available books: Catalog (ms)", columnsMs);
+    }
+    {
+        // Ids in a range, as an unindexed id filter would.
+        int lo = static_cast<int>(kBooks / 4), hi = static_cast<int>(kBooks / 2);
+        size_t rows = 0, columns = 0;
+        double rowsMs = bench::timeMs([&] {
+            rows = 0;
+            for (const Book& b : books) rows += b.id >= lo && b.id <= hi;
+        });
+        double columnsMs = bench::timeMs([&] {
+            columns = 0;
+            for (size_t slot = 0; slot < catalog.size(); ++slot) columns += catalog.id(slot) >= lo && catalog.id(slot) <= hi;
+        });
+        check("id range", rows, columns);
+        bench::report("ids in a range: vector<Book> (ms)", rowsMs);
+        bench::report("ids in a range: Catalog (ms)", columnsMs);
+    }
+    {
+        size_t rows = 0, columns = 0;
+        double rowsMs = bench::timeMs([&] {
+            std::vector<Book> copy = books;
+            rows = copy.size();
+        });
+        double columnsMs = bench::timeMs([&] {
+            Catalog copy = catalog;
+            columns = copy.size();
+        });
+        check("copy", rows, columns);
+        bench::report("copy: vector<Book> (ms)", rowsMs);
+        bench::report("copy: Catalog (ms)", columnsMs);
+    }
+}
@@ -0,0 +1,67 @@
+// GET /books/search?fuzzy=1 on 1M books: searchFuzzy latency and how often
+// the FUZZY_BUDGET_US default (1000us) cuts a query short, for queries of one
+// or two words from random books with one typo in each word of four bytes or
+// more. The same queries without a deadline show what the budget costs.
+#include "bench.hpp"
+#include "text_index.hpp"
+
+namespace {
+
+const size_t kBooks = 1000000;
+const size_t kQueries = 2000;
+
+std::string misspell(std::string word, std::mt19937& rng) {
+    if (word.size() < 4) return word;
+    size_t at = rng() % word.size();
+    char letter = static_cast<char>('a' + rng() % 26);
+    switch (rng() % 3) {
+        case 0: word[at] = letter; break;
+        case 1: word.erase(at, 1); break;
+        default: word.insert(at, 1, letter); break;
+    }
+    return word;
+}
+
+std::vector<std::string> makeQueries(const std::vector<Book>& books, size_t n) {
+    std::mt19937 rng(11);
+    std::vector<std::string> queries;
+    for (size_t q = 0; q < n; ++q) {
+        const Book& b = books[rng() % books.size()];
+        std::vector<std::string> words = tokenize(b.title + " " + b.author);
+        std::shuffle(words.begin(), words.end(), rng);
+        words.resize(1 + rng() % 2);
+        std::string query;
+        for (const auto& w : words) query += (query.empty() ? "" : " ") + misspell(w, rng);
+        queries.push_back(query);
+    }
+    return queries;
+}
+
+}  // namespace
+
+BENCH(fuzzy_search) {
+    std::vector<Book> books = bench::makeBooks(kBooks);
+    std::vector<std::string> queries = makeQueries(books, kQueries);
+    TextIndex index;
+    for (const Book& b : books) index.add(b.id, b.title, b.author);
+
+    for (auto budget : {std::chrono::microseconds(1000), std::chrono::microseconds(std::chrono::hours(1))}) {
+        std::string label = budget.count() == 1000 ? "1000us budget" : "no budget";
+        std::vector<double> us;
+        size_t complete = 0, matched = 0;
+        for (const auto& q : queries) {
+            size_t total;
+            bool done;
+            auto start = std::chrono::steady_clock::now();
+            index.searchFuzzy(q, 20, total, start + budget * 4 / 5, done);  // as the server cuts it
+            us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            complete += done;
+            matched += total > 0;
+        }
+        bench::report(label + ": p50 (us)", bench::percentile(us, 50));
+        bench::report(label + ": p99 (us)", bench::percentile(us, 99));
+        bench::report(label + ": max (us)", bench::percentile(us, 100));
+        bench::report(label + ": complete (%)", 100.0 * double(complete) / double(queries.size()));
+        bench::report(label + ": with matches (%)", 100.0 * double(matched) / double(queries.size()));
+    }
+}
@@ -0,0 +1,72 @@
+// Point lookups by id: IdIndex against the linear walk over the books that
+// findBookById used to do, at 10k, 100k and 1M books, and the index kept in
+// sync through swap-remove deletes the way removeBookById keeps it.
+#include "bench.hpp"
+#include "id_index.hpp"
+#include <random>
+
+namespace {
+
+// The old findBookById.
+const Book* findLinear(const std::vector<Book>& books, int id) {
+    for (const auto& b : books)
+        if (b.id == id) return &b;
+    return nullptr;
+}
+
+}  // namespace
+
+BENCH(id_index_lookup) {
+    for (size_t n : {10000, 100000, 1000000}) {
+        std::vector<Book> books = bench::makeBooks(n);
+        IdIndex index;
+        index.reserve(n);
+        for (size_t i = 0; i < n; ++i) index.put(books[i].id, i);
+
+        std::mt19937 rng(7);
+        std::vector<int> ids(100000);
+        for (int& id : ids) id = static_cast<int>(rng() % (n + n / 10)) + 1;  // about 1 in 11 misses
+
+        size_t found = 0;
+        size_t linearLookups = n >= 1000000 ? 200 : 2000;
+        double linear = bench::timeMs([&] {
+            for (size_t i = 0; i < linearLookups; ++i) found += findLinear(books, ids[i]) != nullptr;
+        }, 3);
+        double hashed = bench::timeMs([&] {
+            for (int id : ids) found += index.find(id) != IdIndex::npos;
+        });
+        std::string label = std::to_string(n) + " books, ";
+        bench::report(label + "linear scan: ns/lookup", linear * 1e6 / double(linearLookups));
+        bench::report(label + "IdIndex: ns/lookup", hashed * 1e6 / double(ids.size()));
+        if (found == 0) std::printf("  (no hits)\n");
+    }
+}
+
+BENCH(id_index_delete) {
+    const size_t n = 1000000;
+    std::vector<Book> books = bench::makeBooks(n);
+    IdIndex index;
+    index.reserve(n);
+    for (size_t i = 0; i < n; ++i) index.put(books[i].id, i);
+
+    std::mt19937 rng(11);
+    size_t deletes = 0;
+    double ms = bench::timeMs([&] {
+        for (int k = 0; k < 100000 && !books.empty(); ++k) {
+            int id = static_cast<int>(rng() % n) + 1;
+            size_t slot = index.find(id);
+            if (slot == IdIndex::npos) continue;
+            if (slot != books.size() - 1) {
+                books[slot] = std::move(books.back());
+                index.put(books[slot].id, slot);
+            }
+            books.pop_back();
+            index.erase(id);
+            ++deletes;
+        }
+    }, 1);
+    size_t stale = 0;
+    for (size_t i = 0; i < books.size(); ++i) stale += index.find(books[i].id) != i;
+    bench::report("1M books, delete + re-key moved slot: ns/delete", ms * 1e6 / double(deletes));
+    bench::report("entries pointing at the wrong slot afterwards", double(stale));
+}
@@ -0,0 +1,64 @@
+// The GET /books body for 100k books: jsonout::appendBook into one string
+// against the json array of to_json() values, dumped, that the handler built
+// before. A second catalog has a quote, a backslash or a tab in every tenth
+// title to exercise escaping. The escape kernels are also timed alone.
+#include "bench.hpp"
+#include "json_writer.hpp"
+
+namespace {
+
+const size_t kBooks = 100000;
+
+std::string treeBody(const std::vector<Book>& books) {
+    json arr = json::array();
+    for (const auto& b : books) arr.push_back(b.to_json());
+    return json{{"books", arr}}.dump();
+}
+
+void writerBody(const std::vector<Book>& books, std::string& out) {
+    out.clear();
+    out += "{\"books\":[";
+    for (size_t i = 0; i < books.size(); ++i) {
+        if (i) out += ',';
+        jsonout::appendBook(out, books[i]);
+    }
+    out += "]}";
+}
+
+void compare(const std::string& label, const std::vector<Book>& books) {
+    std::string tree, out;
+    double treeMs = bench::timeMs([&] { tree = treeBody(books); });
+    double writerMs = bench::timeMs([&] { writerBody(books, out); });
+    if (tree != out) std::printf("  %s: bodies differ\n", label.c_str());
+    bench::report(label + ": to_json + dump (ms)", treeMs);
+    bench::report(label + ": appendBook (ms)", writerMs);
+    bench::report(label + ": to_json + dump allocations", bench::allocationsPer([&] { tree = treeBody(books); }, 1));
+    bench::report(label + ": appendBook allocations", bench::allocationsPer([&] { writerBody(books, out); }, 1));
+}
+
+size_t escapes(jsonout::FindEscapeFn find, const std::string& s) {
+    size_t found = 0;
+    for (size_t i = find(s.data(), s.size()); i < s.size(); i += 1 + find(s.data() + i + 1, s.size() - i - 1)) ++found;
+    return found;
+}
+
+}  // namespace
+
+BENCH(json_writer) {
+    std::printf("  kernel: %s\n", jsonout::kernel().name);
+    std::vector<Book> books = bench::makeBooks(kBooks);
+    compare("clean titles", books);
+
+    const char* specials[] = {"\"", "\\", "\t"};
+    for (size_t i = 0; i < books.size(); i += 10) books[i].title.insert(4, specials[i / 10 % 3]);
+    compare("escapes in 1 of 10", books);
+
+    std::string titles;
+    for (const Book& b : books) titles += b.title;
+    size_t scalar = 0, kernel = 0;
+    double scalarMs = bench::timeMs([&] { scalar = escapes(jsonout::findEscapeScalar, titles); });
+    double kernelMs = bench::timeMs([&] { kernel = escapes(jsonout::kernel().findEscape, titles); });
+    if (scalar != kernel) std::printf("  kernels disagree: %zu vs %zu\n", scalar, kernel);
+    bench::report("find escapes in all titles, scalar (ms)", scalarMs);
+    bench::report(std::string("find escapes in all titles, ") + jsonout::kernel().name + " (ms)", kernelMs);
+}
@@ -0,0 +1,50 @@
+// library_bench [filter]: runs the benchmark cases whose name contains
+// filter, or all of them.
+#include "bench.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> newCalls{0};
+}
+
+uint64_t bench::allocations() { return newCalls.load(std::memory_order_relaxed); }
+
+void* operator new(std::size_t n) {
+    newCalls.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void* operator new(std::size_t n, std::align_val_t a) {
+    newCalls.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(a);
+    if (void* p = std::aligned_alloc(align, (n + align - 1) / align * align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n, std::align_val_t a) { return operator new(n, a); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    int ran = 0;
+    for (const auto& c : bench::cases()) {
+        if (!std::strstr(c.name, filter)) continue;
+        std::printf("%s\n", c.name);
+        c.run();
+        ++ran;
+    }
+    if (!ran) {
+        std::fprintf(stderr, "no benchmark matches \"%s\"\n", filter);
+        return 1;
+    }
+    return 0;
+}
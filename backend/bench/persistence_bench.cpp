@@ -0,0 +1,138 @@
+// Mixed read/write throughput on library.db: one writer saving books (each
+// its own commit, as WriteQueue does with batching off) against three
+// readers doing point reads by id, for two seconds each way. Before: one
+// connection with SQLite's default journal and pragmas, shared by every
+// thread under a mutex, as initDatabase had it. After: Persistence with the
+// default SqliteOptions (WAL, synchronous=NORMAL, mmap, larger cache) and
+// readers on its read-only pool.
+#include "bench.hpp"
+#include "persistence.hpp"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const size_t kBooks = 100000;
+const auto kRun = std::chrono::seconds(2);
+
+std::string freshPath(const char* tag) {
+    std::string path = "/tmp/library_bench_" + std::to_string(getpid()) + "_" + tag + ".db";
+    for (const char* suffix : {"", "-wal", "-shm", "-journal"}) std::remove((path + suffix).c_str());
+    return path;
+}
+
+void removeDb(const std::string& path) {
+    for (const char* suffix : {"", "-wal", "-shm", "-journal"}) std::remove((path + suffix).c_str());
+}
+
+bool readTitle(sqlite3* db, int id) {
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, "SELECT title FROM books WHERE id = ?", -1, &stmt, 0);
+    sqlite3_bind_int(stmt, 1, id);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+struct Throughput {
+    double writes = 0, reads = 0;  // per second
+};
+
+// Runs write(i) on one thread and read(id) on three until kRun is up.
+template <typename Write, typename Read>
+Throughput mixed(Write write, Read read) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> writes{0}, reads{0};
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (int i = 0; !stop; ++i) {
+            write(static_cast<int>(kBooks) + 1 + i);
+            ++writes;
+        }
+    });
+    for (unsigned r = 0; r < 3; ++r)
+        threads.emplace_back([&, r] {
+            std::mt19937 rng(r);
+            while (!stop) {
+                read(static_cast<int>(rng() % kBooks) + 1);
+                ++reads;
+            }
+        });
+    std::this_thread::sleep_for(kRun);
+    stop = true;
+    for (auto& t : threads) t.join();
+    double seconds = std::chrono::duration<double>(kRun).count();
+    return Throughput{writes / seconds, reads / seconds};
+}
+
+Book newBook(int id) { return Book{id, "Bench title " + std::to_string(id), "Bench author", true}; }
+
+}  // namespace
+
+BENCH(persistence_mixed) {
+    std::vector<Book> books = bench::makeBooks(kBooks);
+
+    // Before.
+    {
+        std::string path = freshPath("shared");
+        sqlite3* db;
+        sqlite3_open(path.c_str(), &db);
+        sqlite3_exec(db, "CREATE TABLE books(id INTEGER PRIMARY KEY, title TEXT, author TEXT, isAvailable INTEGER)",
+                     0, 0, 0);
+        sqlite3_exec(db, "BEGIN", 0, 0, 0);
+        sqlite3_stmt* insert;
+        sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO books VALUES(?, ?, ?, ?)", -1, &insert, 0);
+        auto save = [insert](const Book& b) {
+            sqlite3_bind_int(insert, 1, b.id);
+            sqlite3_bind_text(insert, 2, b.title.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(insert, 3, b.author.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(insert, 4, b.isAvailable ? 1 : 0);
+            sqlite3_step(insert);
+            sqlite3_reset(insert);
+        };
+        for (const Book& b : books) save(b);
+        sqlite3_exec(db, "COMMIT", 0, 0, 0);
+
+        std::mutex shared;
+        Throughput t = mixed(
+            [&](int id) {
+                std::lock_guard<std::mutex> lock(shared);
+                save(newBook(id));
+            },
+            [&](int id) {
+                std::lock_guard<std::mutex> lock(shared);
+                readTitle(db, id);
+            });
+        sqlite3_finalize(insert);
+        sqlite3_close(db);
+        removeDb(path);
+        bench::report("shared connection, default pragmas: writes/s", t.writes);
+        bench::report("shared connection, default pragmas: reads/s", t.reads);
+    }
+
+    // After.
+    {
+        std::string path = freshPath("pooled");
+        Persistence store;
+        if (!store.open(path.c_str())) {
+            std::printf("  cannot open %s\n", path.c_str());
+            return;
+        }
+        store.begin();
+        for (const Book& b : books) store.saveBook(b);
+        store.commit();
+
+        Throughput t = mixed([&](int id) { store.saveBook(newBook(id)); },
+                             [&](int id) {
+                                 auto lease = store.reader();
+                                 readTitle(lease.get(), id);
+                             });
+        store.close();
+        removeDb(path);
+        bench::report("WAL + read pool: writes/s", t.writes);
+        bench::report("WAL + read pool: reads/s", t.reads);
+    }
+}
@@ -0,0 +1,132 @@
+// GET /books pages of 50 on 1M books: walking BookOrderIndexes against
+// filtering the whole vector<Book> and sorting what is left, the only way to
+// answer sort=, author=, available= and id ranges before the indexes.
+#include "bench.hpp"
+#include "sorted_index.hpp"
+#include <climits>
+
+namespace {
+
+const size_t kBooks = 1000000;
+const size_t kPage = 50;
+
+using Key = BookOrderIndexes::Key;
+
+bool byTitle(const Book* a, const Book* b) { return a->title != b->title ? a->title < b->title : a->id < b->id; }
+
+// A page the naive way: filter, sort, skip past the cursor, take kPage.
+template <typename Keep, typename Less, typename After>
+std::vector<int> naivePage(const std::vector<Book>& books, Keep keep, Less less, After after) {
+    std::vector<const Book*> rows;
+    for (const Book& b : books)
+        if (keep(b)) rows.push_back(&b);
+    std::sort(rows.begin(), rows.end(), less);
+    std::vector<int> page;
+    for (const Book* b : rows) {
+        if (!after(b)) continue;
+        page.push_back(b->id);
+        if (page.size() == kPage) break;
+    }
+    return page;
+}
+
+// Up to kPage ids from two sorted ranges of slots, merged by less.
+template <typename It, typename Less, typename Keep>
+std::vector<int> mergedPage(const Catalog& books, It a, It aEnd, It b, It bEnd, Less less, Keep keep) {
+    std::vector<int> page;
+    while (page.size() < kPage) {
+        bool aOk = a != aEnd && keep(*a), bOk = b != bEnd && keep(*b);
+        if (!aOk && !bOk) break;
+        if (aOk && (!bOk || less(*a, *b))) page.push_back(books.id(*a++));
+        else page.push_back(books.id(*b++));
+    }
+    return page;
+}
+
+}  // namespace
+
+BENCH(sorted_index_page) {
+    std::vector<Book> books = bench::makeBooks(kBooks);
+    Catalog catalog;
+    for (const Book& b : books) catalog.push_back(b);
+    {
+        // The indexes hold a catalog reference and can't be reassigned, so each build is timed once.
+        BookOrderIndexes added(catalog);
+        double addMs = bench::timeMs([&] { for (size_t slot = 0; slot < catalog.size(); ++slot) added.add(slot); }, 1);
+        bench::report("index 1M books, add() per book (ms)", addMs);
+    }
+    BookOrderIndexes indexes(catalog);
+    double buildMs = bench::timeMs([&] { indexes.build(); }, 1);
+    bench::report("index 1M books, build() (ms)", buildMs);
+
+    const Book& middle = books[kBooks / 2];
+    const std::string& author = middle.author;
+    // The index walks take microseconds, so they are timed over 1000 calls.
+    auto perCallMs = [](auto walk) { return bench::timeMs([&] { for (int c = 0; c < 1000; ++c) walk(); }); };
+    auto report = [](const std::string& what, const std::vector<int>& naive, const std::vector<int>& indexed,
+                     double naiveMs, double indexedMs) {
+        if (naive != indexed) std::printf("  %s: pages differ\n", what.c_str());
+        bench::report(what + ": filter + sort (us)", naiveMs * 1000);
+        bench::report(what + ": indexes (us)", indexedMs);
+    };
+
+    {
+        std::vector<int> naive, indexed;
+        double naiveMs = bench::timeMs([&] {
+            naive = naivePage(books, [](const Book& b) { return b.isAvailable; }, byTitle, [](const Book*) { return true; });
+        }, 3);
+        double indexedMs = perCallMs([&] {
+            indexed.clear();
+            for (auto it = indexes.available.byTitle.begin(); indexed.size() < kPage; ++it) indexed.push_back(catalog.id(*it));
+        });
+        report("available, by title, page 1", naive, indexed, naiveMs, indexedMs);
+    }
+    {
+        Book from = middle;
+        std::vector<int> naive, indexed;
+        double naiveMs = bench::timeMs([&] {
+            naive = naivePage(books, [](const Book& b) { return b.isAvailable; }, byTitle,
+                              [&](const Book* b) { return byTitle(&from, b); });
+        }, 3);
+        double indexedMs = perCallMs([&] {
+            indexed.clear();
+            for (auto it = indexes.available.byTitle.upper_bound(Key{from.title, from.id}); indexed.size() < kPage; ++it)
+                indexed.push_back(catalog.id(*it));
+        });
+        report("available, by title, past cursor", naive, indexed, naiveMs, indexedMs);
+    }
+    {
+        std::vector<int> naive, indexed;
+        double naiveMs = bench::timeMs([&] {
+            naive = naivePage(books, [&](const Book& b) { return b.author == author; },
+                              [](const Book* a, const Book* b) { return a->id < b->id; }, [](const Book*) { return true; });
+        }, 3);
+        double indexedMs = perCallMs([&] {
+            const auto& a = indexes.available.byAuthor;
+            const auto& i = indexes.issued.byAuthor;
+            indexed = mergedPage(catalog, a.lower_bound(Key{author, INT_MIN}), a.end(), i.lower_bound(Key{author, INT_MIN}),
+                                 i.end(), [&](size_t x, size_t y) { return catalog.id(x) < catalog.id(y); },
+                                 [&](size_t slot) { return catalog.author(slot) == author; });
+        });
+        report("one author, by id", naive, indexed, naiveMs, indexedMs);
+    }
+    {
+        int lo = middle.id, hi = middle.id + static_cast<int>(kPage) - 1;
+        std::vector<int> naive, indexed;
+        double naiveMs = bench::timeMs([&] {
+            naive = naivePage(books, [&](const Book& b) { return b.id >= lo && b.id <= hi; },
+                              [](const Book* a, const Book* b) { return a->id < b->id; }, [](const Book*) { return true; });
+        }, 3);
+        double indexedMs = perCallMs([&] {
+            indexed.clear();
+            auto a = indexes.available.byId.lower_bound(lo), i = indexes.issued.byId.lower_bound(lo);
+            while (indexed.size() < kPage) {
+                bool aOk = a != indexes.available.byId.end() && *a <= hi;
+                bool iOk = i != indexes.issued.byId.end() && *i <= hi;
+                if (!aOk && !iOk) break;
+                indexed.push_back(aOk && (!iOk || *a < *i) ? *a++ : *i++);
+            }
+        });
+        report("id range of 50", naive, indexed, naiveMs, indexedMs);
+    }
+}
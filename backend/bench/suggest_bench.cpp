@@ -0,0 +1,78 @@
+// SuggestIndex at 1M books: the startup build (two adds per book, then one
+// refresh), its resident memory, suggest() latency for short and long
+// prefixes, and the cost of one live change (add + refresh) and of one bulk
+// import chunk, which writers pay while holding the data lock.
+#include "bench.hpp"
+#include "suggest_index.hpp"
+#include <fstream>
+#include <malloc.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t kBooks = 1000000;
+
+size_t residentBytes() {
+    malloc_trim(0);
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+}  // namespace
+
+BENCH(suggest_index) {
+    std::vector<Book> books = bench::makeBooks(kBooks);
+
+    size_t before = residentBytes();
+    SuggestIndex index;
+    auto start = std::chrono::steady_clock::now();
+    for (const Book& b : books) {
+        index.add(SuggestIndex::Title, b.title);
+        index.add(SuggestIndex::Author, b.author);
+    }
+    index.refresh();
+    bench::report("build 1M books: ms",
+                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    bench::report("build 1M books: resident MB", double(residentBytes() - before) / 1e6);
+
+    const char* prefixes[] = {"t", "th", "the river", "author", "author storm 4", "garden memory"};
+    for (const char* p : prefixes) {
+        std::vector<double> us;
+        for (int r = 0; r < 200; ++r) {
+            auto s = std::chrono::steady_clock::now();
+            auto hits = index.suggest(p, 10);
+            us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - s).count());
+            if (hits.empty()) std::abort();
+        }
+        bench::report(std::string("suggest \"") + p + "\": p50 us", bench::percentile(us, 50));
+    }
+
+    std::vector<double> us;
+    for (size_t i = 0; i < 20000; ++i) {
+        std::string title = "Fresh title " + std::to_string(i);
+        auto s = std::chrono::steady_clock::now();
+        index.add(SuggestIndex::Title, title);
+        index.refresh();
+        us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - s).count());
+    }
+    bench::report("add + refresh: p50 us", bench::percentile(us, 50));
+    bench::report("add + refresh: p99 us", bench::percentile(us, 99));
+    bench::report("add + refresh: max us", *std::max_element(us.begin(), us.end()));
+
+    // As POST /books/bulk applies them: 4096 books per refresh.
+    std::vector<Book> more = bench::makeBooks(100000, 2);
+    std::vector<double> ms;
+    for (size_t from = 0; from < more.size(); from += 4096) {
+        auto s = std::chrono::steady_clock::now();
+        for (size_t i = from; i < std::min(from + 4096, more.size()); ++i) {
+            index.add(SuggestIndex::Title, more[i].title + " (import)");
+            index.add(SuggestIndex::Author, more[i].author);
+        }
+        index.refresh();
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s).count());
+    }
+    bench::report("4096 books + refresh: p50 ms", bench::percentile(ms, 50));
+    bench::report("4096 books + refresh: max ms", *std::max_element(ms.begin(), ms.end()));
+}
@@ -0,0 +1,96 @@
+// GET /books/search on a 1M-title catalog: TextIndex latency percentiles over
+// queries of one to three words taken from random books (so common words
+// with ~200k postings mix with rare ones), against the substring scan over
+// every title and author that was the only way to search before. Also the
+// cost of fetching every match for the facet counts, ranked and unranked.
+#include "bench.hpp"
+#include "text_index.hpp"
+#include <cctype>
+
+namespace {
+
+const size_t kBooks = 1000000;
+const size_t kQueries = 2000;
+
+std::string lower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+std::vector<std::string> makeQueries(const std::vector<Book>& books, size_t n) {
+    std::mt19937 rng(7);
+    std::vector<std::string> queries;
+    for (size_t q = 0; q < n; ++q) {
+        const Book& b = books[rng() % books.size()];
+        std::vector<std::string> words = tokenize(b.title + " " + b.author);
+        std::shuffle(words.begin(), words.end(), rng);
+        words.resize(1 + rng() % 3);
+        std::string query;
+        for (const auto& w : words) query += (query.empty() ? "" : " ") + w;
+        queries.push_back(query);
+    }
+    return queries;
+}
+
+}  // namespace
+
+BENCH(text_search) {
+    std::vector<Book> books = bench::makeBooks(kBooks);
+    std::vector<std::string> queries = makeQueries(books, kQueries);
+
+    TextIndex index;
+    double buildMs = bench::timeMs(
+        [&] {
+            index = TextIndex();
+            for (const Book& b : books) index.add(b.id, b.title, b.author);
+        },
+        1);
+    bench::report("index 1M books (ms)", buildMs);
+
+    std::vector<double> us;
+    size_t matches = 0;
+    for (const auto& q : queries) {
+        size_t total;
+        auto start = std::chrono::steady_clock::now();
+        index.search(q, 20, total);
+        us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        matches += total;
+    }
+    bench::report("TextIndex search, top 20: p50 (us)", bench::percentile(us, 50));
+    bench::report("TextIndex search, top 20: p99 (us)", bench::percentile(us, 99));
+    bench::report("TextIndex search, top 20: max (us)", bench::percentile(us, 100));
+    bench::report("matches per query", double(matches) / double(queries.size()));
+
+    // GET /books/facets?q=: every match, as before ranked in full by search()
+    // and now unranked from match().
+    for (bool ranked : {true, false}) {
+        std::vector<double> allUs;
+        for (const auto& q : queries) {
+            size_t total;
+            auto start = std::chrono::steady_clock::now();
+            if (ranked) index.search(q, SIZE_MAX, total);
+            else index.match(q);
+            allUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::string label = ranked ? "all matches, search(): " : "all matches, match(): ";
+        bench::report(label + "p50 (us)", bench::percentile(allUs, 50));
+        bench::report(label + "p99 (us)", bench::percentile(allUs, 99));
+    }
+
+    // Before: every word must occur in the lowercased title or author.
+    std::vector<double> scanUs;
+    for (size_t q = 0; q < 20; ++q) {
+        std::vector<std::string> words = tokenize(queries[q]);
+        auto start = std::chrono::steady_clock::now();
+        size_t found = 0;
+        for (const Book& b : books) {
+            std::string text = lower(b.title) + " " + lower(b.author);
+            bool all = true;
+            for (const auto& w : words) all = all && text.find(w) != std::string::npos;
+            found += all;
+        }
+        scanUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    bench::report("substring scan: p50 (us)", bench::percentile(scanUs, 50));
+    bench::report("substring scan: max (us)", bench::percentile(scanUs, 100));
+}
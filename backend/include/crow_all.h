@@ -9185,7 +9185,12 @@ namespace crow
                 }
                 if (complete_request_handler_)
                 {
-                    complete_request_handler_();
+                    // Run it from a local: completing clears the member, and
+                    // when end() is called after the handler returned, this
+                    // function holds the last reference to the connection.
+                    auto complete = std::move(complete_request_handler_);
+                    complete_request_handler_ = nullptr;
+                    complete();
                     manual_length_header = false;
                     skip_body = false;
                 }
@@ -0,0 +1,89 @@
+#pragma once
+#include "catalog.hpp"
+#include "id_index.hpp"
+#include "scan_engine.hpp"
+#include "sorted_index.hpp"
+#include "suggest_index.hpp"
+#include "text_index.hpp"
+#include <atomic>
+#include <cstdint>
+
+// The in-memory side of a book change: the catalog and every per-book index
+// updated together, and the catalog version bumped. Both main.cpp and the
+// stress test change books only through here.
+//
+// Not synchronized: callers hold the data lock exclusively, and call the
+// suggest index's refresh() before releasing it.
+class BookMutations {
+public:
+    BookMutations(Catalog& books, IdIndex& byId, BookOrderIndexes& order, TextIndex& text, SuggestIndex& suggest,
+                  ScanEngine& scan, std::atomic<uint64_t>& version)
+        : books_(books), byId_(byId), order_(order), text_(text), suggest_(suggest), scan_(scan), version_(version) {}
+
+    // Insert or replace by id. Returns true if the id was new.
+    bool upsert(const Book& b) {
+        ++version_;
+        size_t slot = byId_.find(b.id);
+        if (slot != IdIndex::npos) {
+            Book existing = books_.row(slot).book();
+            text_.remove(existing.id, existing.title, existing.author);
+            text_.add(b.id, b.title, b.author);
+            suggest_.remove(SuggestIndex::Title, existing.title);
+            suggest_.remove(SuggestIndex::Author, existing.author);
+            suggest_.add(SuggestIndex::Title, b.title);
+            suggest_.add(SuggestIndex::Author, b.author);
+            scan_.add(b.id, b.title);
+            order_.remove(slot);
+            books_.assign(slot, b);
+            order_.add(slot);
+            return false;
+        }
+        scan_.add(b.id, b.title);
+        text_.add(b.id, b.title, b.author);
+        suggest_.add(SuggestIndex::Title, b.title);
+        suggest_.add(SuggestIndex::Author, b.author);
+        byId_.put(b.id, books_.size());
+        books_.push_back(b);
+        order_.add(books_.size() - 1);
+        return true;
+    }
+
+    // Removal moves the last book into the freed slot so the catalog stays
+    // dense. False if there is no book with id.
+    bool remove(int id) {
+        size_t slot = byId_.find(id);
+        if (slot == IdIndex::npos) return false;
+        ++version_;
+        Book gone = books_.row(slot).book();
+        text_.remove(id, gone.title, gone.author);
+        suggest_.remove(SuggestIndex::Title, gone.title);
+        suggest_.remove(SuggestIndex::Author, gone.author);
+        scan_.remove(id);
+        order_.remove(slot);
+        size_t last = books_.size() - 1;
+        if (slot != last) order_.remove(last);  // the last book moves into slot, so its entries are re-keyed
+        books_.swapRemove(slot);
+        if (slot != last) {
+            byId_.put(books_.id(slot), slot);
+            order_.add(slot);
+        }
+        byId_.erase(id);
+        return true;
+    }
+
+    // Flips a book between available and issued without touching the text indexes.
+    void setAvailable(size_t slot, bool isAvailable) {
+        ++version_;
+        books_.setAvailable(slot, isAvailable);
+        order_.setAvailable(slot, isAvailable);
+    }
+
+private:
+    Catalog& books_;
+    IdIndex& byId_;
+    BookOrderIndexes& order_;
+    TextIndex& text_;
+    SuggestIndex& suggest_;
+    ScanEngine& scan_;
+    std::atomic<uint64_t>& version_;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "catalog.hpp"
+#include "json_writer.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+// The whole-catalog GET /books body, rebuilt at most once per catalog
+// version. A rebuild pins a copy of the catalog under the shared lock (a few
+// memcpys of its columns) and serializes the copy after releasing it, so
+// writers wait for the copy, not for every book to be formatted.
+class BooksBodyCache {
+public:
+    struct Body {
+        uint64_t version = 0;
+        std::shared_ptr<const std::string> json;
+    };
+
+    // books is guarded by lock, and version is bumped under it on every change.
+    template <typename SharedMutex>
+    Body current(const Catalog& books, SharedMutex& lock, const std::atomic<uint64_t>& version) {
+        size_t lastSize = 0;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (body_.json && body_.version == version.load()) return body_;
+            if (body_.json) lastSize = body_.json->size();
+        }
+
+        Body fresh;
+        Catalog pinned;
+        {
+            std::shared_lock<SharedMutex> read(lock);
+            fresh.version = version.load();
+            pinned = books;
+        }
+        std::string out;
+        out.reserve(lastSize + lastSize / 16);  // the catalog rarely moves much between rebuilds
+        out += "{\"books\":[";
+        for (size_t i = 0; i < pinned.size(); ++i) {
+            if (i) out += ',';
+            jsonout::appendBook(out, pinned.row(i));
+        }
+        out += "]}";
+        fresh.json = std::make_shared<const std::string>(std::move(out));
+
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!body_.json || body_.version < fresh.version) body_ = fresh;
+        return fresh;
+    }
+
+private:
+    std::mutex mutex_;
+    Body body_;
+};
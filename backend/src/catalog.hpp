@@ -0,0 +1,259 @@
+#pragma once
+#include "models.hpp"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Interned strings with 32-bit ids. intern() takes a reference and release()
+// drops one; once a string's last reference is gone its id is reused.
+class StringPool {
+public:
+    StringPool() = default;
+    StringPool(StringPool&&) = default;
+    StringPool& operator=(StringPool&&) = default;
+
+    // The lookup table views the strings it indexes, so a copy rebuilds it
+    // over its own.
+    StringPool(const StringPool& other) : strings_(other.strings_), refs_(other.refs_), free_(other.free_) {
+        ids_.reserve(other.ids_.size());
+        for (uint32_t id = 0; id < strings_.size(); ++id)
+            if (refs_[id]) ids_.emplace(strings_[id], id);
+    }
+
+    StringPool& operator=(const StringPool& other) {
+        if (this != &other) *this = StringPool(other);
+        return *this;
+    }
+
+    uint32_t intern(std::string_view s) {
+        auto found = ids_.find(s);
+        if (found != ids_.end()) {
+            ++refs_[found->second];
+            return found->second;
+        }
+        uint32_t id;
+        if (!free_.empty()) {
+            id = free_.back();
+            free_.pop_back();
+            strings_[id] = std::string(s);
+            refs_[id] = 1;
+        } else {
+            id = static_cast<uint32_t>(strings_.size());
+            strings_.emplace_back(s);
+            refs_.push_back(1);
+        }
+        ids_.emplace(strings_[id], id);  // deque elements never move, so the view stays valid
+        return id;
+    }
+
+    void release(uint32_t id) {
+        if (--refs_[id] > 0) return;
+        ids_.erase(strings_[id]);
+        std::string().swap(strings_[id]);
+        free_.push_back(id);
+    }
+
+    const std::string& get(uint32_t id) const { return strings_[id]; }
+    uint32_t refs(uint32_t id) const { return refs_[id]; }
+
+    size_t size() const { return ids_.size(); }
+
+    // Every id handed out so far is below this; released ones have no refs.
+    uint32_t idLimit() const { return static_cast<uint32_t>(strings_.size()); }
+
+    // Heap bytes held for the strings and the lookup table, roughly.
+    size_t bytes() const {
+        size_t total = strings_.size() * (sizeof(std::string) + sizeof(uint32_t)) +
+                       ids_.size() * (sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*));
+        for (const auto& s : strings_)
+            if (s.capacity() > 15) total += s.capacity() + 1;
+        return total;
+    }
+
+private:
+    std::deque<std::string> strings_;
+    std::vector<uint32_t> refs_;
+    std::vector<uint32_t> free_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+class Catalog;
+
+// One catalog row, read through Book's field names, so handlers written
+// against Book read the same. Valid until the catalog next changes.
+class BookView {
+public:
+    BookView(const Catalog& catalog, size_t slot) : catalog_(&catalog), slot_(slot) {}
+
+    int id() const;
+    std::string_view title() const;
+    const std::string& author() const;
+    bool isAvailable() const;
+
+    Book book() const {
+        Book b;
+        b.id = id();
+        b.title = std::string(title());
+        b.author = author();
+        b.isAvailable = isAvailable();
+        return b;
+    }
+
+private:
+    const Catalog* catalog_;
+    size_t slot_;
+};
+
+// The in-memory book table, stored column by column: ids, an availability
+// bitset, interned author ids and title offsets/lengths into one byte arena.
+// A pass over one field (counting available books, say) touches only that
+// column, a bit or four bytes per book. Authors are interned in a
+// StringPool, so prolific authors are stored once. Slots behave like the
+// vector<Book> this replaces: dense, with removal moving the last book into
+// the freed slot. A copy is a handful of column copies, cheap enough to take
+// under a shared lock and read after releasing it (see BooksBodyCache).
+//
+// title() views point into the arena and are invalidated by any mutation.
+class Catalog {
+public:
+    struct Memory {
+        size_t books;
+        size_t columnBytes;
+        size_t titleBytes;      // arena size, including bytes of replaced or removed titles
+        size_t deadTitleBytes;
+        size_t authors;
+        size_t authorBytes;
+        size_t total() const { return columnBytes + titleBytes + authorBytes; }
+    };
+
+    size_t size() const { return ids_.size(); }
+
+    void reserve(size_t books) {
+        ids_.reserve(books);
+        authors_.reserve(books);
+        titleOffsets_.reserve(books);
+        titleLengths_.reserve(books);
+        available_.reserve((books + 63) / 64);
+    }
+
+    int id(size_t slot) const { return ids_[slot]; }
+    bool isAvailable(size_t slot) const { return (available_[slot / 64] >> (slot % 64)) & 1; }
+    const std::string& author(size_t slot) const { return pool_.get(authors_[slot]); }
+    uint32_t authorId(size_t slot) const { return authors_[slot]; }
+    std::string_view title(size_t slot) const {
+        return std::string_view(titles_.data() + titleOffsets_[slot], titleLengths_[slot]);
+    }
+
+    BookView row(size_t slot) const { return BookView(*this, slot); }
+
+    // Interned authors by id: ids run below authorIdLimit(), and an id with
+    // no books is free. Equal ids are equal names, so indexes can key on them.
+    uint32_t authorIdLimit() const { return pool_.idLimit(); }
+    uint32_t authorBooks(uint32_t author) const { return pool_.refs(author); }
+    const std::string& authorName(uint32_t author) const { return pool_.get(author); }
+
+    // Availability bits of slots [64 * w, 64 * w + 64).
+    uint64_t availableWord(size_t w) const { return available_[w]; }
+
+    // Available books, a popcount per 64 slots.
+    size_t countAvailable() const {
+        size_t n = 0;
+        for (uint64_t word : available_) n += static_cast<size_t>(__builtin_popcountll(word));
+        return n;
+    }
+
+    void push_back(const Book& b) {
+        size_t slot = ids_.size();
+        ids_.push_back(b.id);
+        authors_.push_back(pool_.intern(b.author));
+        titleOffsets_.push_back(appendTitle(b.title));
+        titleLengths_.push_back(static_cast<uint32_t>(b.title.size()));
+        if (slot % 64 == 0) available_.push_back(0);
+        setAvailable(slot, b.isAvailable);
+    }
+
+    // Replaces the book in slot (same or different id).
+    void assign(size_t slot, const Book& b) {
+        uint32_t author = pool_.intern(b.author);
+        pool_.release(authors_[slot]);
+        authors_[slot] = author;
+        ids_[slot] = b.id;
+        setAvailable(slot, b.isAvailable);
+        if (title(slot) != b.title) {
+            deadTitleBytes_ += titleLengths_[slot];
+            titleOffsets_[slot] = appendTitle(b.title);
+            titleLengths_[slot] = static_cast<uint32_t>(b.title.size());
+            maybeCompact();
+        }
+    }
+
+    void setAvailable(size_t slot, bool isAvailable) {
+        uint64_t bit = uint64_t(1) << (slot % 64);
+        if (isAvailable) available_[slot / 64] |= bit;
+        else available_[slot / 64] &= ~bit;
+    }
+
+    // Removes slot, moving the last book into it.
+    void swapRemove(size_t slot) {
+        size_t last = ids_.size() - 1;
+        pool_.release(authors_[slot]);
+        deadTitleBytes_ += titleLengths_[slot];
+        ids_[slot] = ids_[last];
+        authors_[slot] = authors_[last];
+        titleOffsets_[slot] = titleOffsets_[last];
+        titleLengths_[slot] = titleLengths_[last];
+        setAvailable(slot, isAvailable(last));
+        ids_.pop_back();
+        authors_.pop_back();
+        titleOffsets_.pop_back();
+        titleLengths_.pop_back();
+        if (last % 64 == 0) available_.pop_back();
+        else setAvailable(last, false);
+        maybeCompact();
+    }
+
+    Memory memory() const {
+        size_t columns = ids_.capacity() * sizeof(int32_t) + authors_.capacity() * sizeof(uint32_t) +
+                         titleOffsets_.capacity() * sizeof(uint32_t) + titleLengths_.capacity() * sizeof(uint32_t) +
+                         available_.capacity() * sizeof(uint64_t);
+        return Memory{ids_.size(), columns, titles_.capacity(), deadTitleBytes_, pool_.size(), pool_.bytes()};
+    }
+
+private:
+    std::vector<int32_t> ids_;
+    std::vector<uint64_t> available_;  // bit slot % 64 of word slot / 64
+    std::vector<uint32_t> authors_;    // StringPool ids
+    std::vector<uint32_t> titleOffsets_;
+    std::vector<uint32_t> titleLengths_;
+    std::string titles_;
+    size_t deadTitleBytes_ = 0;
+    StringPool pool_;
+
+    uint32_t appendTitle(const std::string& title) {
+        uint32_t offset = static_cast<uint32_t>(titles_.size());
+        titles_ += title;
+        return offset;
+    }
+
+    // Rewrites the arena once replaced and removed titles make up half of it.
+    void maybeCompact() {
+        if (deadTitleBytes_ < (1u << 20) || deadTitleBytes_ * 2 < titles_.size()) return;
+        std::string live;
+        live.reserve(titles_.size() - deadTitleBytes_);
+        for (size_t slot = 0; slot < ids_.size(); ++slot) {
+            uint32_t offset = static_cast<uint32_t>(live.size());
+            live.append(titles_, titleOffsets_[slot], titleLengths_[slot]);
+            titleOffsets_[slot] = offset;
+        }
+        titles_ = std::move(live);
+        deadTitleBytes_ = 0;
+    }
+};
+
+inline int BookView::id() const { return catalog_->id(slot_); }
+inline std::string_view BookView::title() const { return catalog_->title(slot_); }
+inline const std::string& BookView::author() const { return catalog_->author(slot_); }
+inline bool BookView::isAvailable() const { return catalog_->isAvailable(slot_); }
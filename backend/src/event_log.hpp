@@ -0,0 +1,136 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Bounded, sequence-numbered log of change notifications for GET /events.
+//
+// All clients read the same log, each from its own position (the SSE
+// Last-Event-ID), so publishing never waits on a client and memory does not
+// grow with slow ones: once the log is full the oldest event is dropped, and
+// a client that was still behind it is told it missed something.
+//
+// A client that has seen everything can wait() for the next event instead
+// of polling; its callback runs once, from the publishing thread or from
+// expire() when its deadline passes. Waiters are bounded too.
+class EventLog {
+public:
+    struct Event {
+        uint64_t id;
+        std::string type;
+        std::string data;  // one line of JSON
+        std::string key;   // events with the same non-empty key supersede each other, see batch()
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    EventLog(size_t capacity, size_t maxWaiters) : capacity_(capacity), maxWaiters_(maxWaiters) {}
+
+    uint64_t publish(std::string type, std::string data, std::string key = {}) {
+        std::vector<Waiter> woken;
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id = ++lastId_;
+            events_.push_back(Event{id, std::move(type), std::move(data), std::move(key)});
+            if (events_.size() > capacity_) events_.pop_front();
+            woken.swap(waiters_);
+        }
+        for (auto& w : woken) w.wake();
+        return id;
+    }
+
+    // Calls wake once, at the first publish after afterId or from the first
+    // expire() past deadline. False, and wake is never called, if there are
+    // events after afterId already (or afterId is not one of ours) or too
+    // many clients are waiting.
+    bool wait(uint64_t afterId, Clock::time_point deadline, std::function<void()> wake) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (afterId != lastId_ || waiters_.size() >= maxWaiters_) return false;
+        waiters_.push_back(Waiter{deadline, std::move(wake)});
+        return true;
+    }
+
+    // Wakes the waiters whose deadline is at or before now.
+    void expire(Clock::time_point now) {
+        std::vector<Waiter> woken;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto kept = waiters_.begin();
+            for (auto& w : waiters_) {
+                if (w.deadline <= now) woken.push_back(std::move(w));
+                else *kept++ = std::move(w);
+            }
+            waiters_.erase(kept, waiters_.end());
+        }
+        for (auto& w : woken) w.wake();
+    }
+
+    size_t waiting() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return waiters_.size();
+    }
+
+    uint64_t lastId() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lastId_;
+    }
+
+    // Events with ids after afterId, oldest first. missed is set if some of
+    // them have already been dropped, or if afterId is from before a restart.
+    std::vector<Event> after(uint64_t afterId, bool& missed) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return afterLocked(afterId, missed);
+    }
+
+    // The events after afterId as one delivery: of events sharing a key only
+    // the newest is kept, and if more than max are left none are returned
+    // and missed is set, as it is by after(). upTo receives the id the
+    // client has seen everything up to once it has these.
+    std::vector<Event> batch(uint64_t afterId, size_t max, bool& missed, uint64_t& upTo) const {
+        std::vector<Event> all;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            all = afterLocked(afterId, missed);
+            upTo = all.empty() && !missed ? afterId : lastId_;
+        }
+        std::vector<Event> kept;
+        std::unordered_set<std::string> seen;
+        for (auto e = all.rbegin(); e != all.rend(); ++e)
+            if (e->key.empty() || seen.insert(e->key).second) kept.push_back(std::move(*e));
+        if (kept.size() > max) {
+            missed = true;
+            kept.clear();
+        }
+        return std::vector<Event>(kept.rbegin(), kept.rend());
+    }
+
+private:
+    struct Waiter {
+        Clock::time_point deadline;
+        std::function<void()> wake;
+    };
+
+    std::vector<Event> afterLocked(uint64_t afterId, bool& missed) const {
+        uint64_t oldest = events_.empty() ? lastId_ + 1 : events_.front().id;
+        missed = afterId > lastId_ || afterId + 1 < oldest;
+        std::vector<Event> out;
+        if (afterId >= lastId_) return out;
+        size_t skip = afterId >= oldest ? static_cast<size_t>(afterId - oldest + 1) : 0;
+        out.assign(events_.begin() + static_cast<std::ptrdiff_t>(skip), events_.end());
+        return out;
+    }
+
+    size_t capacity_;
+    size_t maxWaiters_;
+    std::deque<Event> events_;
+    uint64_t lastId_ = 0;
+    std::vector<Waiter> waiters_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include "catalog.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Browse-page facet counts (books per author, available vs issued), read
+// straight off the catalog instead of recounted from Books per request.
+//
+// The catalog already keeps what facets need: its author pool counts the
+// books per author, and its availability bitset marks the available slots.
+// Facets over a subset (a search result) build a bitmap of the subset's
+// slots and intersect it with that bitset, so availability is a popcount
+// per word and authors are tallied only for the selected slots.
+class FacetIndex {
+public:
+    struct AuthorCount {
+        std::string author;
+        uint32_t count;
+    };
+
+    struct Facets {
+        size_t total = 0;
+        size_t available = 0;
+        size_t issued = 0;
+        std::vector<AuthorCount> authors;  // most books first, at most the requested number
+    };
+
+    explicit FacetIndex(const Catalog& books) : books_(books) {}
+
+    // Facets over the whole catalog.
+    Facets all(size_t topAuthors) const {
+        Facets f;
+        f.total = books_.size();
+        f.available = books_.countAvailable();
+        f.issued = f.total - f.available;
+        std::vector<std::pair<uint32_t, uint32_t>> tally;
+        for (uint32_t a = 0; a < books_.authorIdLimit(); ++a)
+            if (uint32_t n = books_.authorBooks(a)) tally.push_back({a, n});
+        f.authors = top(std::move(tally), topAuthors);
+        return f;
+    }
+
+    // Facets over the books in the given catalog slots.
+    Facets over(const std::vector<size_t>& slots, size_t topAuthors) const {
+        std::vector<uint64_t> selected((books_.size() + 63) / 64, 0);
+        for (size_t slot : slots)
+            if (slot < books_.size()) selected[slot / 64] |= uint64_t(1) << (slot % 64);
+
+        Facets f;
+        std::unordered_map<uint32_t, uint32_t> perAuthor;
+        for (size_t w = 0; w < selected.size(); ++w) {
+            uint64_t sel = selected[w];
+            if (!sel) continue;
+            f.available += static_cast<size_t>(__builtin_popcountll(sel & books_.availableWord(w)));
+            f.total += static_cast<size_t>(__builtin_popcountll(sel));
+            for (uint64_t bits = sel; bits; bits &= bits - 1)
+                ++perAuthor[books_.authorId(w * 64 + static_cast<size_t>(__builtin_ctzll(bits)))];
+        }
+        f.issued = f.total - f.available;
+        f.authors = top(std::vector<std::pair<uint32_t, uint32_t>>(perAuthor.begin(), perAuthor.end()), topAuthors);
+        return f;
+    }
+
+private:
+    const Catalog& books_;
+
+    // (author id, count) pairs -> the k largest counts, ties by name.
+    std::vector<AuthorCount> top(std::vector<std::pair<uint32_t, uint32_t>> tally, size_t k) const {
+        auto better = [this](const auto& x, const auto& y) {
+            return x.second != y.second ? x.second > y.second : books_.authorName(x.first) < books_.authorName(y.first);
+        };
+        if (tally.size() > k) {
+            std::partial_sort(tally.begin(), tally.begin() + k, tally.end(), better);
+            tally.resize(k);
+        } else {
+            std::sort(tally.begin(), tally.end(), better);
+        }
+        std::vector<AuthorCount> out;
+        out.reserve(tally.size());
+        for (const auto& t : tally) out.push_back({books_.authorName(t.first), t.second});
+        return out;
+    }
+};
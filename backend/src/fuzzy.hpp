@@ -0,0 +1,226 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Edit distance between pattern and text counting insertions, deletions,
+// substitutions and adjacent transpositions ("tolkein" -> "tolkien" is one
+// edit). Uses Hyyro's bit-parallel form of Myers' algorithm: one pass over
+// text with O(1) word operations per byte. Returns maxDist + 1 as soon as the
+// distance must exceed maxDist. pattern must be 1..64 bytes.
+inline int editDistanceWithin(const std::string& pattern, const std::string& text, int maxDist) {
+    const size_t m = pattern.size();
+    uint64_t peq[256] = {};
+    for (size_t i = 0; i < m; ++i) peq[static_cast<unsigned char>(pattern[i])] |= uint64_t(1) << i;
+
+    const uint64_t last = uint64_t(1) << (m - 1);
+    uint64_t vp = ~uint64_t(0), vn = 0, d0 = ~uint64_t(0), pmPrev = 0;
+    int score = static_cast<int>(m);
+    for (size_t j = 0; j < text.size(); ++j) {
+        uint64_t pm = peq[static_cast<unsigned char>(text[j])];
+        uint64_t tr = ((~d0 & pm) << 1) & pmPrev;
+        d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = d0 & vp;
+        if (hp & last) ++score;
+        else if (hn & last) --score;
+        uint64_t x = (hp << 1) | 1;  // first row is 0, 1, 2, ...: global alignment, not search
+        vn = x & d0;
+        vp = (hn << 1) | ~(x | d0);
+        pmPrev = pm;
+        // The score can fall by at most one per remaining byte.
+        if (score - static_cast<int>(text.size() - j - 1) > maxDist) return maxDist + 1;
+    }
+    return score;
+}
+
+// Trigram index over a vocabulary of tokens, used to find the tokens within
+// a few edits of a (possibly misspelled) query term without comparing
+// against every token. Tokens are padded as "$$token$", so every edit
+// destroys at most four of a term's distinct trigrams (a transposition
+// touches four); a token sharing fewer than grams - 4 * maxDist trigrams
+// with the term cannot be within maxDist.
+//
+// Trigrams filter poorly in a large vocabulary of similar tokens (a million
+// book numbers share every digit trigram with thousands of others), so for
+// one edit match() looks up each string one edit from the term instead,
+// over the bytes the vocabulary uses, whenever that is fewer lookups than
+// the trigram lists hold.
+class TrigramIndex {
+public:
+    struct Match {
+        const std::string* token;
+        int distance;
+    };
+
+    void insert(const std::string& token) {
+        if (ids_.count(token)) return;
+        uint32_t id;
+        if (!free_.empty()) {
+            id = free_.back();
+            free_.pop_back();
+            tokens_[id] = token;
+        } else {
+            id = static_cast<uint32_t>(tokens_.size());
+            tokens_.push_back(token);
+        }
+        ids_.emplace(token, id);
+        for (uint32_t g : grams(token)) grams_[g].push_back(id);
+        for (unsigned char c : token) ++bytes_[c];
+    }
+
+    void erase(const std::string& token) {
+        auto found = ids_.find(token);
+        if (found == ids_.end()) return;
+        uint32_t id = found->second;
+        for (uint32_t g : grams(token)) {
+            auto list = grams_.find(g);
+            if (list == grams_.end()) continue;
+            auto& ids = list->second;
+            auto it = std::find(ids.begin(), ids.end(), id);
+            if (it != ids.end()) {
+                *it = ids.back();
+                ids.pop_back();
+            }
+            if (ids.empty()) grams_.erase(list);
+        }
+        for (unsigned char c : token) --bytes_[c];
+        ids_.erase(found);
+        tokens_[id].clear();
+        free_.push_back(id);
+    }
+
+    // Tokens within maxDist edits of term, nearest first, at most limit.
+    // Returns false if deadline passed before every candidate was checked
+    // (out is empty if it passed while candidates were still being counted).
+    bool match(const std::string& term, int maxDist, size_t limit,
+               std::chrono::steady_clock::time_point deadline, std::vector<Match>& out) const {
+        out.clear();
+        if (term.empty() || term.size() > 64) return true;
+
+        std::vector<uint32_t> termGrams = grams(term);
+        std::sort(termGrams.begin(), termGrams.end());
+        termGrams.erase(std::unique(termGrams.begin(), termGrams.end()), termGrams.end());
+        int needed = static_cast<int>(termGrams.size()) - 4 * maxDist;
+
+        if (maxDist == 1) {
+            size_t listed = 0;
+            for (uint32_t g : termGrams) {
+                auto list = grams_.find(g);
+                if (list != grams_.end()) listed += list->second.size();
+            }
+            size_t alphabet = 0;
+            for (uint32_t n : bytes_) alphabet += n != 0;
+            // A lookup costs about as much as counting a few list entries.
+            if ((2 * term.size() + 1) * alphabet * 4 < listed) return neighbours(term, limit, deadline, out);
+        }
+
+        // Shared trigram counts per token id (a term has at most 66 grams),
+        // in a flat array: cheap to count into and to drop on a timeout.
+        std::vector<uint8_t> shared(tokens_.size(), 0);
+        std::vector<uint32_t> seen;
+        size_t counted = 0;
+        for (uint32_t g : termGrams) {
+            auto list = grams_.find(g);
+            if (list == grams_.end()) continue;
+            for (uint32_t id : list->second) {
+                if (shared[id]++ == 0) seen.push_back(id);
+                if ((++counted & 4095) == 0 && std::chrono::steady_clock::now() > deadline) return false;
+            }
+        }
+
+        size_t checked = 0;
+        for (uint32_t id : seen) {
+            if (shared[id] < needed) continue;
+            const std::string& token = tokens_[id];
+            int lengthGap = static_cast<int>(token.size()) - static_cast<int>(term.size());
+            if (lengthGap > maxDist || -lengthGap > maxDist) continue;
+            if ((++checked & 63) == 0 && std::chrono::steady_clock::now() > deadline) {
+                finish(out, limit);
+                return false;
+            }
+            int d = editDistanceWithin(term, token, maxDist);
+            if (d <= maxDist) out.push_back({&token, d});
+        }
+        finish(out, limit);
+        return true;
+    }
+
+private:
+    std::vector<std::string> tokens_;
+    std::vector<uint32_t> free_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> grams_;
+    uint32_t bytes_[256] = {};  // occurrences of each byte across the tokens
+
+    // match() for maxDist 1 by looking up the term and every deletion,
+    // transposition, substitution and insertion of it.
+    bool neighbours(const std::string& term, size_t limit, std::chrono::steady_clock::time_point deadline,
+                    std::vector<Match>& out) const {
+        std::vector<std::pair<uint32_t, int>> found;  // (token id, distance)
+        size_t probes = 0;
+        auto probe = [&](const std::string& s, int distance) {
+            auto it = ids_.find(s);
+            if (it != ids_.end()) found.push_back({it->second, distance});
+            return (++probes & 63) != 0 || std::chrono::steady_clock::now() <= deadline;
+        };
+
+        bool onTime = probe(term, 0);
+        std::string v;
+        for (size_t i = 0; onTime && i < term.size(); ++i) {
+            v = term;
+            v.erase(i, 1);
+            onTime = probe(v, 1);
+            if (onTime && i + 1 < term.size() && term[i] != term[i + 1]) {
+                v = term;
+                std::swap(v[i], v[i + 1]);
+                onTime = probe(v, 1);
+            }
+        }
+        for (size_t i = 0; onTime && i <= term.size(); ++i) {
+            for (int c = 0; onTime && c < 256; ++c) {
+                if (!bytes_[c]) continue;
+                if (i < term.size() && static_cast<unsigned char>(term[i]) != c) {
+                    v = term;
+                    v[i] = static_cast<char>(c);
+                    onTime = probe(v, 1);
+                }
+                if (onTime) {
+                    v = term;
+                    v.insert(v.begin() + static_cast<std::ptrdiff_t>(i), static_cast<char>(c));
+                    onTime = probe(v, 1);
+                }
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end(),
+                                [](const auto& a, const auto& b) { return a.first == b.first; }),
+                    found.end());
+        for (const auto& f : found) out.push_back({&tokens_[f.first], f.second});
+        finish(out, limit);
+        return onTime;
+    }
+
+    static std::vector<uint32_t> grams(const std::string& token) {
+        std::string padded = "$$" + token + "$";
+        std::vector<uint32_t> out;
+        out.reserve(padded.size() - 2);
+        for (size_t i = 0; i + 3 <= padded.size(); ++i)
+            out.push_back(uint32_t(static_cast<unsigned char>(padded[i])) << 16 |
+                          uint32_t(static_cast<unsigned char>(padded[i + 1])) << 8 |
+                          uint32_t(static_cast<unsigned char>(padded[i + 2])));
+        return out;
+    }
+
+    static void finish(std::vector<Match>& out, size_t limit) {
+        std::sort(out.begin(), out.end(), [](const Match& a, const Match& b) {
+            return a.distance != b.distance ? a.distance < b.distance : *a.token < *b.token;
+        });
+        if (out.size() > limit) out.resize(limit);
+    }
+};
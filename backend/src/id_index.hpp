@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open-addressing hash map from a record id to its slot in a std::vector.
+// Linear probing with backward-shift deletion, so there are no tombstones and
+// lookups stay short after many deletes.
+class IdIndex {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    IdIndex() { rehash(16); }
+
+    size_t size() const { return count_; }
+
+    void clear() {
+        for (auto& e : entries_) e.slot = npos;
+        count_ = 0;
+    }
+
+    void reserve(size_t n) {
+        size_t cap = 16;
+        while (cap * 7 < n * 10) cap <<= 1;  // keep load factor under 0.7
+        if (cap > entries_.size()) rehash(cap);
+    }
+
+    size_t find(int id) const {
+        size_t i = bucket(id);
+        while (entries_[i].slot != npos) {
+            if (entries_[i].id == id) return entries_[i].slot;
+            i = (i + 1) & mask_;
+        }
+        return npos;
+    }
+
+    // Inserts or overwrites the slot stored for id.
+    void put(int id, size_t slot) {
+        if ((count_ + 1) * 10 > entries_.size() * 7) rehash(entries_.size() * 2);
+        size_t i = bucket(id);
+        while (entries_[i].slot != npos) {
+            if (entries_[i].id == id) {
+                entries_[i].slot = slot;
+                return;
+            }
+            i = (i + 1) & mask_;
+        }
+        entries_[i] = {id, slot};
+        ++count_;
+    }
+
+    bool erase(int id) {
+        size_t i = bucket(id);
+        while (entries_[i].slot != npos && entries_[i].id != id) i = (i + 1) & mask_;
+        if (entries_[i].slot == npos) return false;
+
+        // Shift following entries back into the hole until one is already home.
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask_; entries_[j].slot != npos; j = (j + 1) & mask_) {
+            size_t home = bucket(entries_[j].id);
+            if (((j - home) & mask_) >= ((j - hole) & mask_)) {
+                entries_[hole] = entries_[j];
+                hole = j;
+            }
+        }
+        entries_[hole].slot = npos;
+        --count_;
+        return true;
+    }
+
+private:
+    struct Entry {
+        int id;
+        size_t slot;
+    };
+
+    std::vector<Entry> entries_;
+    size_t mask_ = 0;
+    size_t count_ = 0;
+
+    size_t bucket(int id) const {
+        // Fibonacci hashing spreads sequential ids across the table.
+        uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(id)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h >> 32) & mask_;
+    }
+
+    void rehash(size_t cap) {
+        std::vector<Entry> old(cap, Entry{0, npos});
+        old.swap(entries_);
+        mask_ = cap - 1;
+        count_ = 0;
+        for (const auto& e : old)
+            if (e.slot != npos) put(e.id, e.slot);
+    }
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include "catalog.hpp"
+#include "models.hpp"
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Writes JSON text straight into a caller's string, for responses that are
+// mostly books. Output is byte for byte what json::dump() gives for the same
+// value: keys in sorted order, no whitespace, and only '"', '\\' and control
+// characters escaped. Strings are taken to be valid UTF-8 (everything in the
+// catalog came through the JSON parser), so other bytes are copied as they are.
+namespace jsonout {
+
+// Index of the first byte in [s, s + n) that must be escaped, or n.
+inline size_t findEscapeScalar(const char* s, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x20 || c == '"' || c == '\\') return i;
+    }
+    return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Flags a register of bytes at a time: c <= 0x1f (as max(c, 0x1f) == 0x1f),
+// c == '"' or c == '\\'.
+__attribute__((target("sse2")))
+inline size_t findEscapeSse2(const char* s, size_t n) {
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(c, ctrl), ctrl),
+                                   _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, backslash)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+    return i + findEscapeScalar(s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline size_t findEscapeAvx2(const char* s, size_t n) {
+    const __m256i ctrl = _mm256_set1_epi8(0x1f);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(c, ctrl), ctrl),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(c, quote), _mm256_cmpeq_epi8(c, backslash)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+    return i + findEscapeSse2(s + i, n - i);
+}
+#endif
+
+using FindEscapeFn = size_t (*)(const char*, size_t);
+
+struct Kernel {
+    FindEscapeFn findEscape;
+    const char* name;
+};
+
+// Picked once from what the CPU supports.
+inline const Kernel& kernel() {
+    static const Kernel k = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return Kernel{findEscapeAvx2, "avx2"};
+        if (__builtin_cpu_supports("sse2")) return Kernel{findEscapeSse2, "sse2"};
+#endif
+        return Kernel{findEscapeScalar, "scalar"};
+    }();
+    return k;
+}
+
+inline void appendEscape(std::string& out, unsigned char c) {
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\b': out += "\\b"; break;
+    case '\f': out += "\\f"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default: {
+        static const char hex[] = "0123456789abcdef";
+        const char u[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+        out.append(u, sizeof(u));
+    }
+    }
+}
+
+// Appends s as a quoted JSON string. Clean runs between escapes are copied
+// whole.
+inline void appendString(std::string& out, std::string_view s) {
+    const FindEscapeFn findEscape = kernel().findEscape;
+    out += '"';
+    size_t i = 0;
+    while (i < s.size()) {
+        size_t clean = findEscape(s.data() + i, s.size() - i);
+        out.append(s.data() + i, clean);
+        i += clean;
+        if (i == s.size()) break;
+        appendEscape(out, static_cast<unsigned char>(s[i++]));
+    }
+    out += '"';
+}
+
+template <typename T>
+inline void appendNumber(std::string& out, T value) {
+    static_assert(std::is_integral<T>::value, "integers only");
+    char buf[24];
+    auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+    out.append(buf, static_cast<size_t>(end - buf));
+}
+
+inline void appendBool(std::string& out, bool value) { out += value ? "true" : "false"; }
+
+// Same output as Book::to_json().dump().
+inline void appendBook(std::string& out, int id, std::string_view title, std::string_view author, bool isAvailable) {
+    out += "{\"author\":";
+    appendString(out, author);
+    out += ",\"id\":";
+    appendNumber(out, id);
+    out += ",\"isAvailable\":";
+    appendBool(out, isAvailable);
+    out += ",\"title\":";
+    appendString(out, title);
+    out += '}';
+}
+
+inline void appendBook(std::string& out, const Book& b) { appendBook(out, b.id, b.title, b.author, b.isAvailable); }
+inline void appendBook(std::string& out, const BookView& b) {
+    appendBook(out, b.id(), b.title(), b.author(), b.isAvailable());
+}
+
+}  // namespace jsonout
@@ -0,0 +1,82 @@
+#pragma once
+#include "id_index.hpp"
+#include "models.hpp"
+#include <unordered_map>
+#include <vector>
+
+// Active loans, found by book in O(1) and listed by user in O(k).
+//
+// Loans live in one dense vector (swap-and-pop on return, like the catalog).
+// Each user has a vector of their loans' slots, and every loan remembers its
+// position there, so a return unlinks it from its user in O(1) as well.
+class LoanIndex {
+public:
+    size_t size() const { return loans_.size(); }
+
+    const Loan* byBook(int bookId) const {
+        size_t slot = byBook_.find(bookId);
+        return slot == IdIndex::npos ? nullptr : &loans_[slot];
+    }
+
+    // False, and nothing changes, if the book is already on loan.
+    bool add(const Loan& loan) {
+        if (byBook_.find(loan.bookId) != IdIndex::npos) return false;
+        size_t slot = loans_.size();
+        auto& mine = byUser_[loan.userId];
+        loans_.push_back(loan);
+        userPos_.push_back(mine.size());
+        mine.push_back(slot);
+        byBook_.put(loan.bookId, slot);
+        return true;
+    }
+
+    bool remove(int bookId, Loan* removed = nullptr) {
+        size_t slot = byBook_.find(bookId);
+        if (slot == IdIndex::npos) return false;
+        if (removed) *removed = loans_[slot];
+        unlink(slot);
+        byBook_.erase(bookId);
+
+        size_t last = loans_.size() - 1;
+        if (slot != last) {
+            loans_[slot] = loans_[last];
+            userPos_[slot] = userPos_[last];
+            byUser_[loans_[slot].userId][userPos_[slot]] = slot;
+            byBook_.put(loans_[slot].bookId, slot);
+        }
+        loans_.pop_back();
+        userPos_.pop_back();
+        return true;
+    }
+
+    std::vector<Loan> forUser(int userId) const {
+        std::vector<Loan> out;
+        auto found = byUser_.find(userId);
+        if (found == byUser_.end()) return out;
+        out.reserve(found->second.size());
+        for (size_t slot : found->second) out.push_back(loans_[slot]);
+        return out;
+    }
+
+    void reserve(size_t n) {
+        loans_.reserve(n);
+        userPos_.reserve(n);
+        byBook_.reserve(n);
+    }
+
+private:
+    std::vector<Loan> loans_;
+    std::vector<size_t> userPos_;                          // slot -> position in its user's list
+    IdIndex byBook_;                                       // bookId -> slot
+    std::unordered_map<int, std::vector<size_t>> byUser_;  // userId -> slots
+
+    void unlink(size_t slot) {
+        auto found = byUser_.find(loans_[slot].userId);
+        auto& mine = found->second;
+        size_t pos = userPos_[slot];
+        mine[pos] = mine.back();
+        userPos_[mine[pos]] = pos;
+        mine.pop_back();
+        if (mine.empty()) byUser_.erase(found);
+    }
+};
@@ -1,129 +1,691 @@
 #define CROW_MAIN
 #include "crow_all.h"
 #include "json.hpp"
-#include <sqlite3.h>
+#include "models.hpp"
+#include "catalog.hpp"
+#include "id_index.hpp"
+#include "persistence.hpp"
+#include "write_queue.hpp"
+#include "parallel.hpp"
+#include "snapshot.hpp"
+#include "text_index.hpp"
+#include "suggest_index.hpp"
+#include "scan_engine.hpp"
+#include "sorted_index.hpp"
+#include "facet_index.hpp"
+#include "loan_index.hpp"
+#include "overdue_tracker.hpp"
+#include "event_log.hpp"
+#include "request_arena.hpp"
+#include "json_writer.hpp"
+#include "record_parser.hpp"
+#include "books_cache.hpp"
+#include "book_mutations.hpp"
+#include "writer_priority_mutex.hpp"
 #include <vector>
 #include <string>
+#include <set>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <functional>
 #include <cstdlib> // getenv
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <unistd.h> // sysconf
 
-using json = nlohmann::json;
 using namespace std;
 
-struct Book {
-    int id;
-    string title;
-    string author;
-    bool isAvailable = true;
+// Global data
+Catalog libraryBooks;
+vector<User> libraryUsers;
+IdIndex bookIndex;  // Book::id -> position in libraryBooks
+IdIndex userIndex;  // User::userId -> position in libraryUsers
+BookOrderIndexes bookOrder(libraryBooks);  // id/title/author/availability orderings for GET /books
+TextIndex searchIndex;  // title/author tokens -> book ids, for GET /books/search
+SuggestIndex suggestIndex;  // title/author/user name prefixes, for GET /suggest; writers refresh() it before unlocking
+ScanEngine scanEngine;  // lowercased title arena, for GET /books/scan
+FacetIndex facetIndex(libraryBooks);  // per-author and availability counts, for GET /books/facets
+LoanIndex loans;  // active loans by book and by user; a book on loan is never isAvailable
+OverdueTracker overdueLoans;  // the same loans by due time, split into running and overdue
+// Readers take data_mutex shared (a queued writer goes first, see
+// WriterPriorityMutex); mutations take write_mutex for their whole
+// memory + SQLite path and hold data_mutex exclusively only while touching memory.
+WriterPriorityMutex data_mutex;
+mutex write_mutex;
+
+// Bumped on every change to libraryBooks; always written under data_mutex.
+atomic<uint64_t> catalogVersion{0};
+
+// Every change to libraryBooks goes through here, so the indexes above follow it.
+BookMutations bookMutations(libraryBooks, bookIndex, bookOrder, searchIndex, suggestIndex, scanEngine, catalogVersion);
+
+// Dashboard counters, changed together with what they count so GET /stats
+// reads them without the data lock. Written under data_mutex.
+struct LibraryStats {
+    atomic<size_t> books{0};
+    atomic<size_t> members{0};
+    atomic<size_t> issued{0};   // active loans
+    atomic<size_t> overdue{0};  // active loans past due
+};
+LibraryStats libraryStats;
+
+json statsJson() {
+    return json{{"totalBooks", libraryStats.books.load()},
+                {"totalMembers", libraryStats.members.load()},
+                {"issuedBooks", libraryStats.issued.load()},
+                {"overdueBooks", libraryStats.overdue.load()}};
+}
 
-    json to_json() const {
-        return json{{"id", id}, {"title", title}, {"author", author}, {"isAvailable", isAvailable}};
+// Resident memory of the whole process (catalog, every index, caches and the
+// allocator's slack), from /proc; 0 where that is not available.
+size_t residentBytes() {
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Time spent parsing POST /books bodies, for GET /metrics.
+struct ParseStats {
+    atomic<uint64_t> parsed{0};
+    atomic<uint64_t> rejected{0};
+    atomic<uint64_t> totalNs{0};
+    atomic<uint64_t> lastNs{0};
+    atomic<uint64_t> maxNs{0};
+
+    void record(uint64_t ns, bool ok) {
+        ++(ok ? parsed : rejected);
+        totalNs += ns;
+        lastNs = ns;
+        uint64_t seen = maxNs.load();
+        while (seen < ns && !maxNs.compare_exchange_weak(seen, ns)) {}
     }
+};
+ParseStats bookParseStats;
 
-    static Book from_json(const json& j) {
-        Book b;
-        b.id = j.at("id").get<int>();
-        b.title = j.at("title").get<string>();
-        b.author = j.at("author").get<string>();
-        b.isAvailable = j.value("isAvailable", true);
-        return b;
+json bookParseJson() {
+    uint64_t n = bookParseStats.parsed.load() + bookParseStats.rejected.load();
+    return json{{"parsed", bookParseStats.parsed.load()},
+                {"rejected", bookParseStats.rejected.load()},
+                {"lastNs", bookParseStats.lastNs.load()},
+                {"avgNs", n ? bookParseStats.totalNs.load() / n : 0},
+                {"maxNs", bookParseStats.maxNs.load()}};
+}
+
+// Change notifications for GET /events. Mutations publish while holding
+// write_mutex, so events are in the same order as the changes. Up to
+// EVENTS_CLIENTS up-to-date clients are held waiting for the next one.
+size_t eventLogCapacity() {
+    if (const char* env_p = std::getenv("EVENTS_BUFFER")) return static_cast<size_t>(max(1, std::stoi(env_p)));
+    return 1024;
+}
+size_t eventWaitersMax() {
+    if (const char* env_p = std::getenv("EVENTS_CLIENTS")) return static_cast<size_t>(max(0, std::stoi(env_p)));
+    return 1024;
+}
+EventLog events(eventLogCapacity(), eventWaitersMax());
+const size_t eventsPerResponse = 256;  // after coalescing; more than this and the client resyncs instead
+
+// Serialized GET /books body for one catalog version.
+struct BooksCache {
+    uint64_t version = 0;
+    shared_ptr<const string> body;
+    string etag;
+};
+BooksBodyCache booksBody;
+
+// Distinguishes ETags across restarts, where catalogVersion starts over.
+const string etagPrefix = to_string(chrono::system_clock::now().time_since_epoch().count());
+
+Persistence store;
+
+SqliteOptions sqliteOptions() {
+    SqliteOptions o;
+    if (const char* env_p = std::getenv("SQLITE_WAL")) o.wal = string(env_p) != "0";
+    if (const char* env_p = std::getenv("SQLITE_SYNCHRONOUS")) {
+        string mode = env_p;
+        if (mode == "OFF" || mode == "NORMAL" || mode == "FULL" || mode == "EXTRA") o.synchronous = mode;
+    }
+    if (const char* env_p = std::getenv("SQLITE_MMAP_SIZE")) o.mmapSize = std::stoll(env_p);
+    if (const char* env_p = std::getenv("SQLITE_CACHE_SIZE")) o.cacheSize = std::stoi(env_p);
+    if (const char* env_p = std::getenv("SQLITE_READ_CONNECTIONS")) o.readConnections = max(1, std::stoi(env_p));
+    return o;
+}
+
+WriteQueue::Options writeQueueOptions() {
+    WriteQueue::Options o;
+    if (const char* env_p = std::getenv("WRITE_BATCH_SIZE")) o.maxBatch = max(1, std::stoi(env_p));
+    if (const char* env_p = std::getenv("WRITE_BATCH_DELAY_US")) o.maxDelay = chrono::microseconds(std::stoi(env_p));
+    o.onFailed = [](const Mutation& m) { CROW_LOG_ERROR << "Not saved to library.db: " << m.describe(); };
+    return o;
+}
+WriteQueue writeQueue(store, writeQueueOptions());
+
+const string snapshotPath = "library.snapshot";
+uint64_t snapshotGeneration = UINT64_MAX;  // library.db generation of the last snapshot loaded or written
+PeriodicTask snapshotTask;
+PeriodicTask overdueTask;
+PeriodicTask eventsTask;
+
+// --- Helpers ---
+int64_t nowSeconds() {
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+User* findUserById(int id) {
+    size_t slot = userIndex.find(id);
+    return slot == IdIndex::npos ? nullptr : &libraryUsers[slot];
+}
+
+// Insert or replace by id, same semantics as the INSERT OR REPLACE we persist with.
+// A book on loan stays unavailable whatever b says (only POST /return makes it
+// available again), so b is adjusted and must be persisted as it is on return.
+void addBook(Book& b) {
+    if (loans.byBook(b.id)) b.isAvailable = false;
+    if (bookMutations.upsert(b)) ++libraryStats.books;
+}
+
+void addUser(const User& u) {
+    if (User* existing = findUserById(u.userId)) {
+        suggestIndex.remove(SuggestIndex::UserName, existing->userName);
+        suggestIndex.add(SuggestIndex::UserName, u.userName);
+        *existing = u;
+        return;
     }
+    suggestIndex.add(SuggestIndex::UserName, u.userName);
+    ++libraryStats.members;
+    userIndex.put(u.userId, libraryUsers.size());
+    libraryUsers.push_back(u);
+}
+
+bool removeBookById(int id) {
+    if (!bookMutations.remove(id)) return false;
+    --libraryStats.books;
+    return true;
+}
+
+// Returns the cached GET /books body, rebuilding it only if the catalog changed.
+BooksCache currentBooksBody() {
+    BooksBodyCache::Body b = booksBody.current(libraryBooks, data_mutex, catalogVersion);
+    return BooksCache{b.version, std::move(b.json), "\"" + etagPrefix + "-" + to_string(b.version) + "\""};
+}
+
+// A GET /books listing: filters, order, and the keyset position to resume after.
+struct BookQuery {
+    enum Sort { ById, ByTitle, ByAuthor };
+    Sort sort = ById;
+    bool hasAuthor = false;
+    string author;
+    int available = -1;  // -1 any, 0 issued only, 1 available only
+    int minId = INT_MIN;
+    int maxId = INT_MAX;
+    bool hasCursor = false;
+    int cursor = 0;      // id of the last book on the previous page
+    size_t limit = 100;
 };
 
-struct User {
-    int userId;
-    string userName;
+// A listed book, copied out under the lock into the request's arena.
+struct PageBook {
+    int id;
+    arena::string title;
+    arena::string author;
+    bool isAvailable;
+};
 
-    json to_json() const {
-        return json{{"userId", userId}, {"userName", userName}};
+struct BooksPage {
+    arena::vector<PageBook> books;
+    bool hasMore = false;
+    bool badCursor = false;  // cursor book no longer exists, so its sort key is unknown
+};
+
+// Walks up to two ordered sets of one type (the availability sides of one
+// order) as a single merged order: each set starts where seek puts it, the
+// walk stops at the first entry failing inRange, and visit gets each entry
+// until it returns true (page full). Returns whether an in-range entry is
+// left, i.e. whether there is a next page.
+template <typename Set, typename Seek, typename InRange, typename Visit>
+bool walkMerged(const vector<const Set*>& sets, Seek seek, InRange inRange, Visit visit) {
+    vector<typename Set::const_iterator> at;
+    for (const Set* s : sets) at.push_back(seek(*s));
+    auto live = [&](size_t i) { return at[i] != sets[i]->end() && inRange(*at[i]); };
+    for (;;) {
+        size_t next = sets.size();
+        for (size_t i = 0; i < sets.size(); ++i)
+            if (live(i) && (next == sets.size() || sets[i]->key_comp()(*at[i], *at[next]))) next = i;
+        if (next == sets.size()) return false;
+        if (visit(*at[next]++)) break;
+    }
+    for (size_t i = 0; i < sets.size(); ++i)
+        if (live(i)) return true;
+    return false;
+}
+
+// Seeks the ordered index that matches the requested order and filters in
+// O(log n) and reads the page from there in O(k): availability picks the
+// index side, an author seeks to that author's run, the cursor to the book
+// after it, and an id range bounds an id-ordered walk.
+//
+// An id range combined with title or author order is a second dimension no
+// single order covers. If the range holds few books (up to about
+// sqrt(limit * n)) they are collected in id order and the page picked from
+// them; otherwise the order is walked and out-of-range books skipped, which
+// takes about limit * n / range steps. Either way a page costs at most about
+// sqrt(limit * n), not n.
+BooksPage readBooksPage(const BookQuery& q) {
+    using Key = BookOrderIndexes::Key;
+    using Orders = BookOrderIndexes::Orders;
+    BooksPage page;
+    shared_lock<WriterPriorityMutex> lock(data_mutex);
+
+    bool keyOrder = q.sort == BookQuery::ByTitle || (q.sort == BookQuery::ByAuthor && !q.hasAuthor);
+    size_t lastSlot = q.hasCursor ? bookIndex.find(q.cursor) : IdIndex::npos;
+    if (q.hasCursor && lastSlot == IdIndex::npos && keyOrder) {
+        page.badCursor = true;
+        return page;
+    }
+    Book last = lastSlot != IdIndex::npos ? libraryBooks.row(lastSlot).book() : Book{};
+
+    vector<const Orders*> sides;
+    if (q.available != 0) sides.push_back(&bookOrder.available);
+    if (q.available != 1) sides.push_back(&bookOrder.issued);
+    auto of = [&sides](auto order) {
+        vector<const decay_t<decltype(sides[0]->*order)>*> sets;
+        for (const Orders* o : sides) sets.push_back(&(o->*order));
+        return sets;
+    };
+    // Adds the book; returns true once the page is full.
+    auto add = [&](size_t slot) {
+        page.books.push_back(PageBook{libraryBooks.id(slot), arena::string(libraryBooks.title(slot)),
+                                      arena::string(libraryBooks.author(slot)), libraryBooks.isAvailable(slot)});
+        return page.books.size() >= q.limit;
+    };
+    auto anyBook = [](size_t) { return true; };
+    auto ofAuthor = [&](size_t slot) { return libraryBooks.author(slot) == q.author; };
+    // One author's books are contiguous in byAuthor and in id order.
+    auto authorById = [&](const auto& keys) {
+        return q.hasCursor && q.cursor >= q.minId ? keys.upper_bound(Key{q.author, q.cursor}) : keys.lower_bound(Key{q.author, q.minId});
+    };
+    auto authorInIds = [&](size_t slot) { return ofAuthor(slot) && libraryBooks.id(slot) <= q.maxId; };
+
+    if (!keyOrder && !q.hasAuthor) {
+        page.hasMore = walkMerged(
+            of(&Orders::byId),
+            [&](const set<int>& ids) { return q.hasCursor && q.cursor >= q.minId ? ids.upper_bound(q.cursor) : ids.lower_bound(q.minId); },
+            [&](int id) { return id <= q.maxId; }, [&](int id) { return add(bookIndex.find(id)); });
+        return page;
+    }
+    if (!keyOrder) {
+        page.hasMore = walkMerged(of(&Orders::byAuthor), authorById, authorInIds, add);
+        return page;
     }
 
-    static User from_json(const json& j) {
-        User u;
-        u.userId = j.at("userId").get<int>();
-        u.userName = j.at("userName").get<string>();
-        return u;
+    // Title order (within one author, if given) or author order, past the cursor's key.
+    bool byTitle = q.sort == BookQuery::ByTitle;
+    Key after{byTitle ? string_view(last.title) : string_view(last.author), last.id};
+    if (q.minId != INT_MIN || q.maxId != INT_MAX) {
+        size_t cap = max(4 * q.limit, static_cast<size_t>(sqrt(double(q.limit) * double(libraryBooks.size()))));
+        vector<size_t> slots;
+        auto collect = [&](size_t slot) {
+            slots.push_back(slot);
+            return slots.size() > cap;
+        };
+        if (q.hasAuthor)
+            walkMerged(of(&Orders::byAuthor), [&](const auto& keys) { return keys.lower_bound(Key{q.author, q.minId}); }, authorInIds, collect);
+        else
+            walkMerged(of(&Orders::byId), [&](const set<int>& ids) { return ids.lower_bound(q.minId); },
+                       [&](int id) { return id <= q.maxId; }, [&](int id) { return collect(bookIndex.find(id)); });
+        if (slots.size() <= cap) {
+            auto pick = [&](auto less) {
+                if (q.hasCursor)
+                    slots.erase(remove_if(slots.begin(), slots.end(), [&](size_t s) { return !less(after, s); }), slots.end());
+                size_t keep = min(slots.size(), q.limit + 1);
+                partial_sort(slots.begin(), slots.begin() + keep, slots.end(), less);
+                page.hasMore = slots.size() > q.limit;
+                for (size_t i = 0; i < slots.size() && i < q.limit; ++i) add(slots[i]);
+            };
+            if (byTitle) pick(BookOrderIndexes::TitleOrder{&libraryBooks});
+            else pick(BookOrderIndexes::AuthorOrder{&libraryBooks});
+            return page;
+        }
     }
+    auto addInIds = [&](size_t slot) {
+        int id = libraryBooks.id(slot);
+        return id >= q.minId && id <= q.maxId && add(slot);
+    };
+    auto start = [&](const auto& keys) { return q.hasCursor ? keys.upper_bound(after) : keys.begin(); };
+    if (byTitle && q.hasAuthor) {
+        BookOrderIndexes::AuthorTitleKey from{q.author, after.text, after.id};
+        page.hasMore = walkMerged(
+            of(&Orders::byAuthorTitle),
+            [&](const auto& keys) { return q.hasCursor ? keys.upper_bound(from) : keys.lower_bound(BookOrderIndexes::AuthorTitleKey{q.author, "", INT_MIN}); },
+            ofAuthor, addInIds);
+    } else if (byTitle) {
+        page.hasMore = walkMerged(of(&Orders::byTitle), start, anyBook, addInIds);
+    } else {
+        page.hasMore = walkMerged(of(&Orders::byAuthor), start, anyBook, addInIds);
+    }
+    return page;
+}
+
+// Parses an integer query parameter; false if present but malformed or out of range.
+bool parseIntParam(const char* text, long long lo, long long hi, long long& out) {
+    if (!text) return true;
+    char* end = nullptr;
+    errno = 0;
+    long long v = strtoll(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || v < lo || v > hi) return false;
+    out = v;
+    return true;
+}
+
+// Queues m for library.db; call with write_mutex held so the queue sees mutations
+// in memory order. The future resolves when m's batch commits, or immediately
+// for ack-after-enqueue callers.
+future<bool> persist(Mutation m, bool ackAfterCommit) {
+    if (ackAfterCommit) return writeQueue.enqueueAndWait(std::move(m));
+    writeQueue.enqueue(std::move(m));
+    promise<bool> queued;
+    queued.set_value(true);
+    return queued.get_future();
+}
+
+// Same as persist(), with the whole group committed in one transaction.
+future<bool> persist(vector<Mutation> group, bool ackAfterCommit) {
+    if (ackAfterCommit) return writeQueue.enqueueGroupAndWait(std::move(group));
+    writeQueue.enqueueGroup(std::move(group));
+    promise<bool> queued;
+    queued.set_value(true);
+    return queued.get_future();
+}
+
+// Reply to a mutation that is already live in memory and published. If its
+// commit failed it is not rolled back (later writes may build on it), so the
+// client gets 202 with "persisted": false rather than an error: the change
+// is in effect but may not survive a restart. The writer logs the failure.
+template <typename Json = json>
+crow::response applied(bool persisted, Json body = Json{{"success", true}}) {
+    if (persisted) return crow::response{arena::dump(body)};
+    body["persisted"] = false;
+    return crow::response(202, arena::dump(body));
+}
+
+// Writes are acknowledged after commit unless the client passes ?ack=enqueue.
+bool wantsCommitAck(const crow::request& req) {
+    const char* ack = req.url_params.get("ack");
+    return !(ack && string(ack) == "enqueue");
+}
+
+// --- Bulk import
+// Records from a JSON array or NDJSON body; errors[i] is empty iff records[i] is valid.
+template <typename T>
+struct BulkInput {
+    vector<T> records;
+    vector<string> errors;
 };
 
-// Global data
-vector<Book> libraryBooks;
-vector<User> libraryUsers;
-mutex data_mutex;
+// Parses and validates the body, NDJSON lines in parallel, without building
+// a json tree. Returns false if the body is neither a JSON array nor NDJSON.
+template <typename T>
+bool parseBulk(const crow::request& req, BulkInput<T>& in) {
+    const string& body = req.body;
+    size_t first = body.find_first_not_of(" \t\r\n");
+    bool ndjson = req.get_header_value("Content-Type").find("ndjson") != string::npos ||
+                  (first != string::npos && body[first] != '[');
 
-sqlite3* db;
+    if (!ndjson) return RecordParser<T>::parseArray(body, in.records, in.errors);
 
-// --- Helpers ---
-Book* findBookById(int id) {
-    for (auto& book : libraryBooks)
-        if (book.id == id) return &book;
-    return nullptr;
+    vector<pair<size_t, size_t>> lines;
+    for (size_t pos = 0; pos < body.size();) {
+        size_t end = body.find('\n', pos);
+        if (end == string::npos) end = body.size();
+        if (body.find_first_not_of(" \t\r", pos) < end) lines.emplace_back(pos, end);
+        pos = end + 1;
+    }
+    in.records.resize(lines.size());
+    in.errors.resize(lines.size());
+    parallelFor(lines.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            RecordParser<T>::parse(body.begin() + lines[i].first, body.begin() + lines[i].second, in.records[i], in.errors[i]);
+    });
+    return true;
 }
 
-User* findUserById(int id) {
-    for (auto& user : libraryUsers)
-        if (user.userId == id) return &user;
-    return nullptr;
+// Records a bulk import applies per hold of the data lock; readers get in
+// between chunks, so a large import never blocks them for more than one.
+const size_t importChunk = 4096;
+
+// Applies the valid records of a bulk body with one reservation and persists
+// them as a single transaction; invalid records are reported by index.
+// Records are persisted as add() leaves them. The import holds write_mutex
+// throughout, so no other change interleaves, but takes the data lock one
+// chunk at a time: readers may see part of an import, never part of a record.
+template <typename T, typename Rows, typename Add>
+crow::response importBulk(const crow::request& req, Rows& target, IdIndex& index,
+                          Add add, Mutation (*toMutation)(const T&)) {
+    BulkInput<T> in;
+    if (!parseBulk(req, in))
+        return crow::response(400, R"({"success":false,"message":"Body must be a JSON array or NDJSON"})");
+
+    arena::Scope scope;
+    arena_json errors = arena_json::array();
+    size_t inserted = 0;
+    for (size_t i = 0; i < in.records.size(); ++i) {
+        if (in.errors[i].empty()) ++inserted;
+        else errors.push_back(arena_json{{"index", i}, {"message", in.errors[i]}});
+    }
+
+    future<bool> saved;
+    if (inserted) {
+        lock_guard<mutex> writer(write_mutex);
+        vector<Mutation> group;
+        group.reserve(inserted);
+        {
+            unique_lock<WriterPriorityMutex> lock(data_mutex);
+            target.reserve(target.size() + inserted);
+            index.reserve(index.size() + inserted);
+        }
+        for (size_t from = 0; from < in.records.size(); from += importChunk) {
+            unique_lock<WriterPriorityMutex> lock(data_mutex);
+            for (size_t i = from; i < min(from + importChunk, in.records.size()); ++i) {
+                if (!in.errors[i].empty()) continue;
+                add(in.records[i]);
+                group.push_back(toMutation(in.records[i]));
+            }
+            suggestIndex.refresh();
+        }
+        saved = persist(std::move(group), wantsCommitAck(req));
+        events.publish("import", json{{"inserted", inserted}}.dump());
+    }
+    return applied(!inserted || saved.get(),
+                   arena_json{{"success", true}, {"inserted", inserted}, {"failed", errors.size()}, {"errors", std::move(errors)}});
+}
+
+// --- Overdue loans
+// Called once for each loan as it passes its due time, outside the data lock.
+void onLoanOverdue(const Loan& l) {
+    CROW_LOG_INFO << "Loan of book " << l.bookId << " to user " << l.userId << " is overdue";
+    events.publish("overdue", l.to_json().dump());
+}
+
+// Moves loans that have come due into the overdue set. Readers are only
+// blocked when something is actually due.
+void checkOverdue() {
+    int64_t now = nowSeconds();
+    {
+        shared_lock<WriterPriorityMutex> lock(data_mutex);
+        if (overdueLoans.nextDue() > now) return;
+    }
+    vector<Loan> due;
+    {
+        unique_lock<WriterPriorityMutex> lock(data_mutex);
+        for (int bookId : overdueLoans.advance(now)) due.push_back(*loans.byBook(bookId));
+        libraryStats.overdue += due.size();
+    }
+    for (const auto& l : due) onLoanOverdue(l);
+}
+
+// --- Snapshot
+// Captures the catalog at a committed generation; skipped if nothing changed.
+void saveSnapshot() {
+    string bytes;
+    uint64_t generation;
+    {
+        lock_guard<mutex> writer(write_mutex);  // no new mutations while capturing
+        writeQueue.flush();                     // memory and library.db now agree
+        generation = store.generation();
+        if (generation == snapshotGeneration) return;
+        if (writeQueue.failed()) {
+            // Memory holds changes library.db does not; a snapshot stamped with
+            // this generation would bring them back after a restart.
+            CROW_LOG_WARNING << "Skipping snapshot: " << writeQueue.failed() << " mutations failed to save";
+            return;
+        }
+        shared_lock<WriterPriorityMutex> lock(data_mutex);
+        bytes = snapshot::encode(generation, libraryBooks, libraryUsers);
+    }
+    if (!snapshot::writeFile(snapshotPath, bytes)) {
+        CROW_LOG_ERROR << "Failed to write " << snapshotPath;
+        return;
+    }
+    snapshotGeneration = generation;
+    CROW_LOG_INFO << "Wrote " << snapshotPath << " at generation " << generation << " (" << bytes.size() << " bytes)";
 }
 
 // --- Load data from SQLite
-void initDatabase() {
-    sqlite3_open("library.db", &db);
+// False if library.db cannot be opened; nothing else is loaded then.
+bool initDatabase() {
+    using clock = chrono::steady_clock;
+    auto ms = [](clock::time_point from, clock::time_point to) {
+        return chrono::duration_cast<chrono::milliseconds>(to - from).count();
+    };
 
-    const char* create_books = "CREATE TABLE IF NOT EXISTS books(id INTEGER PRIMARY KEY, title TEXT, author TEXT, isAvailable INTEGER)";
-    sqlite3_exec(db, create_books, 0, 0, 0);
+    auto started = clock::now();
+    if (!store.open("library.db", sqliteOptions())) {
+        CROW_LOG_CRITICAL << "Cannot open library.db: " << store.lastError();
+        return false;
+    }
+    auto opened = clock::now();
 
-    const char* create_users = "CREATE TABLE IF NOT EXISTS users(userId INTEGER PRIMARY KEY, userName TEXT)";
-    sqlite3_exec(db, create_users, 0, 0, 0);
+    // Loans are not in the snapshot; they load alongside whichever source is used.
+    auto loanRows = async(launch::async, [] { return store.loadLoans(); });
 
-    // Load books
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, "SELECT id, title, author, isAvailable FROM books", -1, &stmt, 0);
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Book b;
-        b.id = sqlite3_column_int(stmt, 0);
-        b.title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        b.author = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        b.isAvailable = sqlite3_column_int(stmt, 3) != 0;
-        libraryBooks.push_back(b);
-    }
-    sqlite3_finalize(stmt);
-
-    // Load users
-    sqlite3_prepare_v2(db, "SELECT userId, userName FROM users", -1, &stmt, 0);
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        User u;
-        u.userId = sqlite3_column_int(stmt, 0);
-        u.userName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        libraryUsers.push_back(u);
-    }
-    sqlite3_finalize(stmt);
-}
-
-// --- Save helpers
-void saveBook(const Book& b) {
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO books(id, title, author, isAvailable) VALUES(?, ?, ?, ?)", -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, b.id);
-    sqlite3_bind_text(stmt, 2, b.title.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, b.author.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 4, b.isAvailable ? 1 : 0);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-}
-
-void saveUser(const User& u) {
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO users(userId, userName) VALUES(?, ?)", -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, u.userId);
-    sqlite3_bind_text(stmt, 2, u.userName.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    // A snapshot taken at the current generation replaces the table scans.
+    uint64_t generation = store.generation();
+    string why;
+    bool fromSnapshot = snapshot::read(snapshotPath, generation, libraryBooks, libraryUsers, why);
+    if (fromSnapshot) {
+        snapshotGeneration = generation;
+    } else {
+        CROW_LOG_INFO << "Snapshot " << why << ", loading from library.db";
+        // Books and users load concurrently on separate read connections.
+        auto books = async(launch::async, [] { return store.loadBooks(); });
+        libraryUsers = store.loadUsers();
+        libraryBooks = books.get();
+    }
+    vector<Loan> activeLoans = loanRows.get();
+    auto loaded = clock::now();
+
+    // Each index builds on its own thread. Slots are visited in id order
+    // (SQLite already returns them that way) so sorted structures only append.
+    vector<size_t> byId(libraryBooks.size());
+    for (size_t i = 0; i < byId.size(); ++i) byId[i] = i;
+    if (fromSnapshot)
+        sort(byId.begin(), byId.end(), [](size_t a, size_t b) { return libraryBooks.id(a) < libraryBooks.id(b); });
+
+    // Every build reports its own time, logged below, so a slow start names its index.
+    vector<pair<const char*, future<chrono::milliseconds::rep>>> indexers;
+    auto index = [&](const char* name, function<void()> build) {
+        indexers.emplace_back(name, async(launch::async, [build = std::move(build), ms] {
+            auto from = clock::now();
+            build();
+            return ms(from, clock::now());
+        }));
+    };
+    index("users", [] {
+        userIndex.reserve(libraryUsers.size());
+        for (size_t i = 0; i < libraryUsers.size(); ++i) userIndex.put(libraryUsers[i].userId, i);
+    });
+    index("text", [&byId] {
+        for (size_t i : byId) searchIndex.add(libraryBooks.id(i), string(libraryBooks.title(i)), libraryBooks.author(i));
+    });
+    index("scan", [] {
+        for (size_t i = 0; i < libraryBooks.size(); ++i) scanEngine.add(libraryBooks.id(i), string(libraryBooks.title(i)));
+    });
+    index("loans", [&activeLoans] {
+        loans.reserve(activeLoans.size());
+        for (const auto& l : activeLoans) {
+            loans.add(l);
+            overdueLoans.track(l.bookId, l.dueAt);
+        }
+        overdueLoans.advance(nowSeconds());  // already overdue at startup: no event
+    });
+    index("suggest", [] {
+        for (size_t i = 0; i < libraryBooks.size(); ++i) {
+            suggestIndex.add(SuggestIndex::Title, string(libraryBooks.title(i)));
+            suggestIndex.add(SuggestIndex::Author, libraryBooks.author(i));
+        }
+        for (const auto& u : libraryUsers) suggestIndex.add(SuggestIndex::UserName, u.userName);
+        suggestIndex.refresh();
+    });
+    index("order", [] { bookOrder.build(); });
+    auto idsFrom = clock::now();
+    bookIndex.reserve(libraryBooks.size());
+    for (size_t i : byId) bookIndex.put(libraryBooks.id(i), i);
+    string took = "ids " + to_string(ms(idsFrom, clock::now())) + "ms";
+    for (auto& [name, done] : indexers) took += string(", ") + name + " " + to_string(done.get()) + "ms";
+    ++catalogVersion;
+    libraryStats.books = libraryBooks.size();
+    libraryStats.members = libraryUsers.size();
+    libraryStats.issued = loans.size();
+    libraryStats.overdue = overdueLoans.overdueCount();
+    auto indexed = clock::now();
+
+    CROW_LOG_INFO << "Startup: open " << ms(started, opened) << "ms, load (" << (fromSnapshot ? "snapshot" : "sqlite") << ") " << libraryBooks.size() << " books and "
+                  << libraryUsers.size() << " users, " << activeLoans.size() << " loans " << ms(opened, loaded) << "ms, index " << ms(loaded, indexed)
+                  << "ms, total " << ms(started, indexed) << "ms";
+    CROW_LOG_INFO << "Index: " << took;
+    CROW_LOG_INFO << "Catalog: " << libraryBooks.memory().total() << " bytes for " << libraryBooks.size() << " books";
+    return true;
 }
 
 // --- Main ---
+// Ends res with the events after `after` as a text/event-stream, see GET
+// /events. resuming: the client gave one of our ids; missed: it gave
+// someone else's.
+void sendEvents(crow::response& res, uint64_t after, bool resuming, bool missed, int retryMs) {
+    vector<EventLog::Event> pending;
+    uint64_t upTo = events.lastId();
+    if (resuming) pending = events.batch(after, eventsPerResponse, missed, upTo);
+
+    string body = "retry: " + to_string(retryMs) + "\n\n";
+    if (missed) body += "event: resync\ndata: {}\n\n";
+    for (const auto& e : pending)
+        body += "id: " + etagPrefix + "-" + to_string(e.id) + "\nevent: " + e.type + "\ndata: " + e.data + "\n\n";
+    if (!resuming || missed || !pending.empty())
+        body += "id: " + etagPrefix + "-" + to_string(upTo) + "\nevent: stats\ndata: " + statsJson().dump() + "\n\n";
+
+    res.body = std::move(body);
+    res.set_header("Content-Type", "text/event-stream");
+    res.set_header("Cache-Control", "no-cache");
+    res.end();
+}
+
 int main() {
-    initDatabase();
+    if (!initDatabase()) return 1;
+    writeQueue.start();
+
+    int snapshotInterval = 300;
+    if (const char* env_p = std::getenv("SNAPSHOT_INTERVAL_S")) snapshotInterval = std::stoi(env_p);
+    if (snapshotInterval > 0) snapshotTask.start(chrono::seconds(snapshotInterval), saveSnapshot);
+    overdueTask.start(chrono::seconds(1), checkOverdue);
+    eventsTask.start(chrono::seconds(1), [] { events.expire(EventLog::Clock::now()); });
 
     crow::SimpleApp app;
     app.middleware().add<crow::middleware::CORS>();
@@ -132,28 +694,431 @@ int main() {
     int port = 8080;
     if (const char* env_p = std::getenv("PORT")) port = std::stoi(env_p);
 
+    int eventsRetryMs = 250;
+    if (const char* env_p = std::getenv("EVENTS_RETRY_MS")) eventsRetryMs = max(100, std::stoi(env_p));
+    chrono::seconds eventsHold(25);
+    if (const char* env_p = std::getenv("EVENTS_HOLD_S")) eventsHold = chrono::seconds(max(1, std::stoi(env_p)));
+
+    chrono::microseconds fuzzyBudget(1000);
+    if (const char* env_p = std::getenv("FUZZY_BUDGET_US")) fuzzyBudget = chrono::microseconds(std::stoi(env_p));
+    // Fuzzy matching stops at 80% of the budget, leaving the rest for
+    // ranking what it found and writing the response.
+    chrono::microseconds fuzzyCutoff = fuzzyBudget * 4 / 5;
+
     // Routes
-    CROW_ROUTE(app, "/books").methods("GET"_method)([]() {
-        json arr = json::array();
-        for (const auto& b : libraryBooks) arr.push_back(b.to_json());
-        return crow::response{json{{"books", arr}}.dump()};
+    // Without parameters the whole catalog is returned from the version cache.
+    // ?limit=&cursor= pages the listing; cursor is the last id of the previous page.
+    // ?sort=id|title|author orders it, ?author= and ?available=true|false filter it,
+    // and ?minId=&maxId= bound the ids.
+    // ?format=ndjson emits one book per line with the next cursor in X-Next-Cursor.
+    CROW_ROUTE(app, "/books").methods("GET"_method)([](const crow::request& req) {
+        const char* limitParam = req.url_params.get("limit");
+        const char* cursorParam = req.url_params.get("cursor");
+        const char* formatParam = req.url_params.get("format");
+        const char* sortParam = req.url_params.get("sort");
+        const char* authorParam = req.url_params.get("author");
+        const char* availableParam = req.url_params.get("available");
+        const char* minIdParam = req.url_params.get("minId");
+        const char* maxIdParam = req.url_params.get("maxId");
+        bool ndjson = formatParam && string(formatParam) == "ndjson";
+
+        if (limitParam || cursorParam || ndjson || sortParam || authorParam || availableParam || minIdParam || maxIdParam) {
+            BookQuery q;
+            long long limit = ndjson ? 10000 : 100, cursor = 0, minId = INT_MIN, maxId = INT_MAX;
+            if (!parseIntParam(limitParam, 1, ndjson ? 100000 : 1000, limit) ||
+                !parseIntParam(cursorParam, INT_MIN, INT_MAX, cursor) ||
+                !parseIntParam(minIdParam, INT_MIN, INT_MAX, minId) ||
+                !parseIntParam(maxIdParam, INT_MIN, INT_MAX, maxId))
+                return crow::response(400, R"({"success":false,"message":"Invalid limit, cursor or id range"})");
+            string sortName = sortParam ? sortParam : "id";
+            string availableName = availableParam ? availableParam : "";
+            if ((sortName != "id" && sortName != "title" && sortName != "author") ||
+                (availableParam && availableName != "true" && availableName != "false"))
+                return crow::response(400, R"({"success":false,"message":"Invalid sort or available"})");
+
+            q.sort = sortName == "title" ? BookQuery::ByTitle : sortName == "author" ? BookQuery::ByAuthor : BookQuery::ById;
+            q.hasAuthor = authorParam != nullptr;
+            if (authorParam) q.author = authorParam;
+            if (availableParam) q.available = availableName == "true" ? 1 : 0;
+            q.minId = static_cast<int>(minId);
+            q.maxId = static_cast<int>(maxId);
+            q.hasCursor = cursorParam != nullptr;
+            q.cursor = static_cast<int>(cursor);
+            q.limit = static_cast<size_t>(limit);
+
+            arena::Scope scope;
+            BooksPage page = readBooksPage(q);
+            if (page.badCursor)
+                return crow::response(400, R"({"success":false,"message":"Cursor book no longer exists"})");
+            string nextCursor = page.hasMore ? to_string(page.books.back().id) : "null";
+
+            crow::response res;
+            size_t bytes = 64;
+            for (const auto& b : page.books) bytes += b.title.size() + b.author.size() + 64;
+            res.body.reserve(bytes);
+            if (ndjson) {
+                for (const auto& b : page.books) {
+                    jsonout::appendBook(res.body, b.id, b.title, b.author, b.isAvailable);
+                    res.body += '\n';
+                }
+                res.set_header("Content-Type", "application/x-ndjson");
+                res.set_header("X-Next-Cursor", nextCursor);
+            } else {
+                res.body = "{\"books\":[";
+                for (size_t i = 0; i < page.books.size(); ++i) {
+                    if (i) res.body += ',';
+                    const PageBook& b = page.books[i];
+                    jsonout::appendBook(res.body, b.id, b.title, b.author, b.isAvailable);
+                }
+                res.body += "],\"nextCursor\":" + nextCursor + "}";
+            }
+            return res;
+        }
+
+        BooksCache cached = currentBooksBody();
+        const string& ifNoneMatch = req.get_header_value("If-None-Match");
+        crow::response res;
+        res.set_header("ETag", cached.etag);
+        if (ifNoneMatch == "*" || ifNoneMatch.find(cached.etag) != string::npos) {
+            res.code = 304;
+            return res;
+        }
+        res.body = *cached.body;
+        return res;
     });
 
     CROW_ROUTE(app, "/books").methods("POST"_method)([](const crow::request& req) {
-        auto x = json::parse(req.body, nullptr, false);
-        if (x.is_discarded() || !x.contains("id") || !x.contains("title") || !x.contains("author"))
+        arena::Scope scope;
+        Book b;
+        string error;
+        auto parseStart = chrono::steady_clock::now();
+        bool parsed = BookParser::parse(req.body, b, error);
+        bookParseStats.record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                                  chrono::steady_clock::now() - parseStart).count()), parsed);
+        if (!parsed)
+            return crow::response(400, arena::dump(arena_json{{"success", false}, {"message", error}}));
+
+        future<bool> saved;
+        {
+            lock_guard<mutex> writer(write_mutex);
+            {
+                unique_lock<WriterPriorityMutex> lock(data_mutex);
+                addBook(b);
+                suggestIndex.refresh();
+            }
+            saved = persist(Mutation::saveBook(b), wantsCommitAck(req));
+            events.publish("book", arena::dump(arena_json{{"op", "saved"}, {"book", b.to_json<arena_json>()}}), "book:" + to_string(b.id));
+        }
+        return applied<arena_json>(saved.get());
+    });
+
+    // Books whose title or author contain every word of q, best matches first.
+    // fuzzy=1 also accepts misspelled words, within FUZZY_BUDGET_US (default 1000us);
+    // "complete": false means the budget ran out: the books are the best of
+    // those found in time, and total counts only those.
+    CROW_ROUTE(app, "/books/search").methods("GET"_method)([fuzzyCutoff](const crow::request& req) {
+        const char* q = req.url_params.get("q");
+        const char* fuzzyParam = req.url_params.get("fuzzy");
+        bool fuzzy = fuzzyParam && string(fuzzyParam) == "1";
+        long long limit = 20;
+        if (!q || !parseIntParam(req.url_params.get("limit"), 1, 100, limit))
+            return crow::response(400, R"({"success":false,"message":"Missing q or invalid limit"})");
+
+        string body = "{\"books\":[";
+        size_t total;
+        bool complete = true;
+        {
+            shared_lock<WriterPriorityMutex> lock(data_mutex);
+            auto hits = fuzzy ? searchIndex.searchFuzzy(q, static_cast<size_t>(limit), total,
+                                                        chrono::steady_clock::now() + fuzzyCutoff, complete)
+                              : searchIndex.search(q, static_cast<size_t>(limit), total);
+            for (size_t i = 0; i < hits.size(); ++i) {
+                if (i) body += ',';
+                jsonout::appendBook(body, libraryBooks.row(bookIndex.find(hits[i].id)));
+            }
+        }
+        body += ']';
+        if (fuzzy) body += complete ? ",\"complete\":true" : ",\"complete\":false";
+        body += ",\"total\":";
+        jsonout::appendNumber(body, total);
+        body += '}';
+        return crow::response{std::move(body)};
+    });
+
+    // Browse-page counts: books per author (top authors=N, default 20) and
+    // available vs issued, over the whole catalog or over the books matching
+    // search query q (fuzzy=1 as for /books/search).
+    CROW_ROUTE(app, "/books/facets").methods("GET"_method)([fuzzyCutoff](const crow::request& req) {
+        const char* q = req.url_params.get("q");
+        const char* fuzzyParam = req.url_params.get("fuzzy");
+        bool fuzzy = fuzzyParam && string(fuzzyParam) == "1";
+        long long authors = 20;
+        if (!parseIntParam(req.url_params.get("authors"), 0, 1000, authors))
+            return crow::response(400, R"({"success":false,"message":"Invalid authors"})");
+
+        FacetIndex::Facets facets;
+        bool complete = true;
+        {
+            shared_lock<WriterPriorityMutex> lock(data_mutex);
+            if (!q) {
+                facets = facetIndex.all(static_cast<size_t>(authors));
+            } else {
+                auto ids = fuzzy ? searchIndex.matchFuzzy(q, chrono::steady_clock::now() + fuzzyCutoff, complete)
+                                 : searchIndex.match(q);
+                vector<size_t> slots;
+                slots.reserve(ids.size());
+                for (int id : ids) slots.push_back(bookIndex.find(id));
+                facets = facetIndex.over(slots, static_cast<size_t>(authors));
+            }
+        }
+        arena::Scope scope;
+        arena_json arr = arena_json::array();
+        for (const auto& a : facets.authors) arr.push_back(arena_json{{"author", a.author}, {"count", a.count}});
+        arena_json body{{"total", facets.total},
+                        {"availability", {{"available", facets.available}, {"issued", facets.issued}}},
+                        {"authors", std::move(arr)}};
+        if (q && fuzzy) body["complete"] = complete;
+        return crow::response{arena::dump(body)};
+    });
+
+    // Admin filter: books whose title, author or either (field=title|author|any,
+    // default any) contain q anywhere, case-insensitively, in ascending id order.
+    CROW_ROUTE(app, "/books/scan").methods("GET"_method)([](const crow::request& req) {
+        const char* q = req.url_params.get("q");
+        const char* fieldParam = req.url_params.get("field");
+        string fieldName = fieldParam ? fieldParam : "any";
+        long long limit = 100;
+        if (!q || !parseIntParam(req.url_params.get("limit"), 1, 1000, limit) ||
+            (fieldName != "title" && fieldName != "author" && fieldName != "any"))
+            return crow::response(400, R"({"success":false,"message":"Missing q or invalid field or limit"})");
+        ScanEngine::Field field = fieldName == "title" ? ScanEngine::Title
+                                : fieldName == "author" ? ScanEngine::Author : ScanEngine::Any;
+
+        string body = "{\"books\":[";
+        size_t total;
+        {
+            shared_lock<WriterPriorityMutex> lock(data_mutex);
+            auto ids = scanEngine.scan(libraryBooks, q, field, static_cast<size_t>(limit), total);
+            for (size_t i = 0; i < ids.size(); ++i) {
+                if (i) body += ',';
+                jsonout::appendBook(body, libraryBooks.row(bookIndex.find(ids[i])));
+            }
+        }
+        body += "],\"total\":";
+        jsonout::appendNumber(body, total);
+        body += '}';
+        return crow::response{std::move(body)};
+    });
+
+    // Search-box completions: titles, authors and member names starting with prefix
+    // (or with a later word starting with it), most common first.
+    CROW_ROUTE(app, "/suggest").methods("GET"_method)([](const crow::request& req) {
+        const char* prefix = req.url_params.get("prefix");
+        long long limit = 8;
+        if (!prefix || !parseIntParam(req.url_params.get("limit"), 1, SuggestIndex::kCache, limit))
+            return crow::response(400, R"({"success":false,"message":"Missing prefix or invalid limit"})");
+
+        static const char* kinds[] = {"title", "author", "user"};
+        arena::Scope scope;
+        arena_json arr = arena_json::array();
+        {
+            shared_lock<WriterPriorityMutex> lock(data_mutex);
+            for (const auto& s : suggestIndex.suggest(prefix, static_cast<size_t>(limit)))
+                arr.push_back(arena_json{{"text", s.text}, {"type", kinds[s.kind]}, {"count", s.weight}});
+        }
+        return crow::response{arena::dump(arena_json{{"suggestions", std::move(arr)}})};
+    });
+
+    CROW_ROUTE(app, "/books/<int>").methods("DELETE"_method)([](const crow::request& req, int id) {
+        arena::Scope scope;
+        future<bool> saved;
+        {
+            lock_guard<mutex> writer(write_mutex);
+            bool removed;
+            {
+                unique_lock<WriterPriorityMutex> lock(data_mutex);
+                if (loans.byBook(id))
+                    return crow::response(400, R"({"success":false,"message":"Book is on loan"})");
+                removed = removeBookById(id);
+                suggestIndex.refresh();
+            }
+            if (!removed)
+                return crow::response(404, R"({"success":false,"message":"Book not found"})");
+            saved = persist(Mutation::deleteBook(id), wantsCommitAck(req));
+            events.publish("book", arena::dump(arena_json{{"op", "removed"}, {"id", id}}), "book:" + to_string(id));
+        }
+        return applied<arena_json>(saved.get());
+    });
+
+    // Body is a JSON array or NDJSON (one record per line).
+    CROW_ROUTE(app, "/books/bulk").methods("POST"_method)([](const crow::request& req) {
+        return importBulk<Book>(req, libraryBooks, bookIndex, addBook, Mutation::saveBook);
+    });
+
+    CROW_ROUTE(app, "/users/bulk").methods("POST"_method)([](const crow::request& req) {
+        return importBulk<User>(req, libraryUsers, userIndex, addUser, Mutation::saveUser);
+    });
+
+    CROW_ROUTE(app, "/metrics").methods("GET"_method)([]() {
+        json catalog;
+        {
+            shared_lock<WriterPriorityMutex> lock(data_mutex);
+            Catalog::Memory m = libraryBooks.memory();
+            catalog = json{{"books", m.books},
+                           {"available", libraryBooks.countAvailable()},
+                           {"authors", m.authors},
+                           {"columnBytes", m.columnBytes},
+                           {"titleBytes", m.titleBytes},
+                           {"deadTitleBytes", m.deadTitleBytes},
+                           {"authorBytes", m.authorBytes},
+                           {"bytesPerBook", m.books ? double(m.total()) / m.books : 0.0}};
+        }
+        return crow::response{json{{"writeQueue", writeQueue.stats()}, {"scanKernel", ScanEngine::kernelName()}, {"escapeKernel", jsonout::kernel().name}, {"catalog", catalog}, {"bookParse", bookParseJson()}, {"residentBytes", residentBytes()}, {"eventsWaiting", events.waiting()}}.dump()};
+    });
+
+    // Lends a book: {"bookId", "userId", "days"} with days 1..365, default 14.
+    // The loan and the availability flip commit in one transaction.
+    CROW_ROUTE(app, "/issue").methods("POST"_method)([](const crow::request& req) {
+        arena::Scope scope;
+        auto x = arena_json::parse(req.body, nullptr, false);
+        if (x.is_discarded() || !x.is_object() || !x.contains("bookId") || !x.contains("userId") ||
+            !json_is_int(x["bookId"]) || !json_is_int(x["userId"]))
             return crow::response(400, R"({"success":false,"message":"Missing fields"})");
+        int days = 14;
+        if (x.contains("days")) {
+            if (!json_is_int(x["days"]) || x["days"].get<int>() < 1 || x["days"].get<int>() > 365)
+                return crow::response(400, R"({"success":false,"message":"Invalid days"})");
+            days = x["days"].get<int>();
+        }
+
+        int64_t now = nowSeconds();
+        Loan loan{x["bookId"].get<int>(), x["userId"].get<int>(), now, now + int64_t(days) * 86400};
+        future<bool> saved;
+        {
+            lock_guard<mutex> writer(write_mutex);
+            {
+                unique_lock<WriterPriorityMutex> lock(data_mutex);
+                size_t slot = bookIndex.find(loan.bookId);
+                if (slot == IdIndex::npos)
+                    return crow::response(404, R"({"success":false,"message":"Book not found"})");
+                if (!findUserById(loan.userId))
+                    return crow::response(404, R"({"success":false,"message":"User not found"})");
+                if (!libraryBooks.isAvailable(slot) || !loans.add(loan))
+                    return crow::response(400, R"({"success":false,"message":"Book is already issued"})");
+                overdueLoans.track(loan.bookId, loan.dueAt);
+                ++libraryStats.issued;
+                bookMutations.setAvailable(slot, false);
+            }
+            saved = persist(vector<Mutation>{Mutation::setAvailability(loan.bookId, false), Mutation::saveLoan(loan)},
+                            wantsCommitAck(req));
+            events.publish("availability", arena::dump(arena_json{{"id", loan.bookId}, {"isAvailable", false}}), "availability:" + to_string(loan.bookId));
+        }
+        return applied(saved.get(), arena_json{{"success", true}, {"loan", loan.to_json<arena_json>()}});
+    });
+
+    // Ends the loan of {"bookId"} and makes the book available again.
+    CROW_ROUTE(app, "/return").methods("POST"_method)([](const crow::request& req) {
+        arena::Scope scope;
+        auto x = arena_json::parse(req.body, nullptr, false);
+        if (x.is_discarded() || !x.is_object() || !x.contains("bookId") || !json_is_int(x["bookId"]))
+            return crow::response(400, R"({"success":false,"message":"Missing fields"})");
+
+        int bookId = x["bookId"].get<int>();
+        Loan loan;
+        future<bool> saved;
+        {
+            lock_guard<mutex> writer(write_mutex);
+            {
+                unique_lock<WriterPriorityMutex> lock(data_mutex);
+                if (!loans.remove(bookId, &loan))
+                    return crow::response(404, R"({"success":false,"message":"Book is not on loan"})");
+                if (overdueLoans.isOverdue(bookId)) --libraryStats.overdue;
+                overdueLoans.untrack(bookId);
+                --libraryStats.issued;
+                size_t slot = bookIndex.find(bookId);
+                if (slot != IdIndex::npos) bookMutations.setAvailable(slot, true);
+            }
+            saved = persist(vector<Mutation>{Mutation::setAvailability(bookId, true), Mutation::deleteLoan(bookId)},
+                            wantsCommitAck(req));
+            events.publish("availability", arena::dump(arena_json{{"id", bookId}, {"isAvailable", true}}), "availability:" + to_string(bookId));
+        }
+        return applied(saved.get(), arena_json{{"success", true}, {"loan", loan.to_json<arena_json>()}});
+    });
+
+    CROW_ROUTE(app, "/users/<int>/loans").methods("GET"_method)([](int userId) {
+        arena::Scope scope;
+        arena_json arr = arena_json::array();
+        {
+            shared_lock<WriterPriorityMutex> lock(data_mutex);
+            if (!findUserById(userId))
+                return crow::response(404, R"({"success":false,"message":"User not found"})");
+            for (const auto& l : loans.forUser(userId)) arr.push_back(l.to_json<arena_json>());
+        }
+        return crow::response{arena::dump(arena_json{{"loans", std::move(arr)}})};
+    });
+
+    // Dashboard cards, from counters; constant time at any catalog size.
+    CROW_ROUTE(app, "/stats").methods("GET"_method)([]() {
+        return crow::response{statsJson().dump()};
+    });
+
+    // Live dashboard updates as a text/event-stream for EventSource. Each
+    // response carries the events since Last-Event-ID and ends; the "retry"
+    // field makes the browser reconnect after eventsRetryMs with its last id.
+    // A client that is already up to date is held instead: the handler
+    // returns without ending the response, which keeps only the connection
+    // (no worker thread), and it is ended on its io thread at the next event
+    // or after eventsHold. Events: book, availability, import, overdue, with
+    // only the newest per book of each kind; then a coalesced stats event if
+    // anything changed. resync means events were missed, or too many to
+    // send, and the client should reload. Ids are "<server start>-<seq>", so
+    // a restart shows up as resync too.
+    CROW_ROUTE(app, "/events").methods("GET"_method)([eventsRetryMs, eventsHold](const crow::request& req, crow::response& res) {
+        string lastEventId = req.get_header_value("Last-Event-ID");
+        if (lastEventId.empty() && req.url_params.get("lastEventId")) lastEventId = req.url_params.get("lastEventId");
+
+        uint64_t after = 0;
+        bool resuming = false;
+        size_t dash = lastEventId.rfind('-');
+        if (dash != string::npos && lastEventId.compare(0, dash, etagPrefix) == 0) {
+            char* end = nullptr;
+            errno = 0;
+            after = strtoull(lastEventId.c_str() + dash + 1, &end, 10);
+            resuming = errno == 0 && *end == '\0' && end != lastEventId.c_str() + dash + 1;
+        }
+
+        if (resuming) {
+            auto* io = req.io_context;
+            crow::response* held = &res;
+            auto wake = [io, held, after, eventsRetryMs] {
+                crow::asio::post(*io, [held, after, eventsRetryMs] { sendEvents(*held, after, true, false, eventsRetryMs); });
+            };
+            if (events.wait(after, EventLog::Clock::now() + eventsHold, wake)) return;
+        }
+        sendEvents(res, after, resuming, !resuming && !lastEventId.empty(), eventsRetryMs);
+    });
 
-        Book b = Book::from_json(x);
-        libraryBooks.push_back(b);
-        saveBook(b);
-        return crow::response(R"({"success":true})");
+    // Loans past their due time, as of the last check (at most a second old).
+    CROW_ROUTE(app, "/loans/overdue").methods("GET"_method)([]() {
+        arena::Scope scope;
+        arena_json arr = arena_json::array();
+        {
+            shared_lock<WriterPriorityMutex> lock(data_mutex);
+            for (int bookId : overdueLoans.overdue()) arr.push_back(loans.byBook(bookId)->to_json<arena_json>());
+        }
+        size_t count = arr.size();
+        return crow::response{arena::dump(arena_json{{"loans", std::move(arr)}, {"count", count}})};
     });
 
-    // Add more routes like /users, issue/return as needed
+    // Add more routes like /users as needed
 
     app.port(port).multithreaded().run();
 
-    sqlite3_close(db);
+    eventsTask.stop();
+    overdueTask.stop();
+    snapshotTask.stop();
+    saveSnapshot();
+    writeQueue.stop();
+    store.close();
     return 0;
 }
@@ -0,0 +1,48 @@
+#pragma once
+#include "json.hpp"
+#include <climits>
+#include <cstdint>
+#include <string>
+
+using json = nlohmann::json;
+
+// True if v is an integer that fits in an int.
+template <typename Json>
+bool json_is_int(const Json& v) {
+    if (v.is_number_unsigned()) return v.template get<uint64_t>() <= static_cast<uint64_t>(INT_MAX);
+    return v.is_number_integer() && v.template get<int64_t>() >= INT_MIN && v.template get<int64_t>() <= INT_MAX;
+}
+
+struct Book {
+    int id;
+    std::string title;
+    std::string author;
+    bool isAvailable = true;
+
+    template <typename Json = json>
+    Json to_json() const {
+        return Json{{"id", id}, {"title", title}, {"author", author}, {"isAvailable", isAvailable}};
+    }
+};
+
+struct User {
+    int userId;
+    std::string userName;
+
+    json to_json() const {
+        return json{{"userId", userId}, {"userName", userName}};
+    }
+};
+
+// An issued book. Times are Unix seconds; a book has at most one loan.
+struct Loan {
+    int bookId;
+    int userId;
+    int64_t issuedAt;
+    int64_t dueAt;
+
+    template <typename Json = json>
+    Json to_json() const {
+        return Json{{"bookId", bookId}, {"userId", userId}, {"issuedAt", issuedAt}, {"dueAt", dueAt}};
+    }
+};
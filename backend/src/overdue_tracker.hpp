@@ -0,0 +1,108 @@
+#pragma once
+#include "id_index.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Splits active loans into those still running and those past due, without
+// scanning. Running loans sit in a min-heap on due time, indexed by book id
+// so a return removes its entry in O(log n); advance() pops whatever has come
+// due into the overdue set, which lists in O(k) and removes in O(1).
+class OverdueTracker {
+public:
+    void track(int bookId, int64_t dueAt) {
+        untrack(bookId);
+        heapPos_.put(bookId, heap_.size());
+        heap_.push_back({dueAt, bookId});
+        siftUp(heap_.size() - 1);
+    }
+
+    void untrack(int bookId) {
+        size_t pos = heapPos_.find(bookId);
+        if (pos != IdIndex::npos) {
+            heapPos_.erase(bookId);
+            size_t last = heap_.size() - 1;
+            if (pos != last) {
+                heap_[pos] = heap_[last];
+                heapPos_.put(heap_[pos].bookId, pos);
+            }
+            heap_.pop_back();
+            if (pos < heap_.size()) {
+                int moved = heap_[pos].bookId;
+                siftUp(pos);
+                siftDown(heapPos_.find(moved));
+            }
+            return;
+        }
+        pos = overduePos_.find(bookId);
+        if (pos == IdIndex::npos) return;
+        overduePos_.erase(bookId);
+        if (pos != overdue_.size() - 1) {
+            overdue_[pos] = overdue_.back();
+            overduePos_.put(overdue_[pos], pos);
+        }
+        overdue_.pop_back();
+    }
+
+    // Moves every loan due at or before now into the overdue set and
+    // returns their book ids, earliest due first.
+    std::vector<int> advance(int64_t now) {
+        std::vector<int> due;
+        while (!heap_.empty() && heap_[0].dueAt <= now) {
+            int bookId = heap_[0].bookId;
+            untrack(bookId);
+            overduePos_.put(bookId, overdue_.size());
+            overdue_.push_back(bookId);
+            due.push_back(bookId);
+        }
+        return due;
+    }
+
+    const std::vector<int>& overdue() const { return overdue_; }
+    size_t overdueCount() const { return overdue_.size(); }
+    bool isOverdue(int bookId) const { return overduePos_.find(bookId) != IdIndex::npos; }
+
+    // Due time of the next loan to fall overdue, or INT64_MAX if none.
+    int64_t nextDue() const { return heap_.empty() ? INT64_MAX : heap_[0].dueAt; }
+
+private:
+    struct Entry {
+        int64_t dueAt;
+        int bookId;
+    };
+
+    std::vector<Entry> heap_;
+    IdIndex heapPos_;  // book id -> position in heap_
+    std::vector<int> overdue_;
+    IdIndex overduePos_;  // book id -> position in overdue_
+
+    static bool before(const Entry& a, const Entry& b) {
+        return a.dueAt != b.dueAt ? a.dueAt < b.dueAt : a.bookId < b.bookId;
+    }
+
+    void swapEntries(size_t a, size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        heapPos_.put(heap_[a].bookId, a);
+        heapPos_.put(heap_[b].bookId, b);
+    }
+
+    void siftUp(size_t pos) {
+        while (pos > 0) {
+            size_t parent = (pos - 1) / 2;
+            if (!before(heap_[pos], heap_[parent])) break;
+            swapEntries(pos, parent);
+            pos = parent;
+        }
+    }
+
+    void siftDown(size_t pos) {
+        for (;;) {
+            size_t smallest = pos;
+            for (size_t child = 2 * pos + 1; child <= 2 * pos + 2 && child < heap_.size(); ++child)
+                if (before(heap_[child], heap_[smallest])) smallest = child;
+            if (smallest == pos) return;
+            swapEntries(pos, smallest);
+            pos = smallest;
+        }
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One worker per hardware thread but the caller's, started on first use and
+// shared by every parallelFor, so concurrent requests queue for the same
+// cores instead of each starting their own threads.
+class WorkerPool {
+public:
+    static WorkerPool& instance() {
+        static WorkerPool pool(std::max<size_t>(1, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+    // Runs one queued task on the calling thread; false if none was queued.
+    bool runOne() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tasks_.empty()) return false;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_ = false;
+
+    explicit WorkerPool(size_t threads) {
+        workers_.reserve(threads);
+        for (size_t t = 0; t < threads; ++t) workers_.emplace_back([this] { work(); });
+    }
+
+    void work() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// Runs fn(begin, end) over [0, n) in contiguous chunks, one per hardware
+// thread, on the calling thread plus the shared WorkerPool. Ranges smaller
+// than minChunk per thread are not worth handing off and run inline. While
+// its chunks are pending the caller runs queued chunks itself rather than
+// sleeping, so a busy pool slows a call down but never stalls it.
+template <typename Fn>
+void parallelFor(size_t n, size_t minChunk, Fn fn) {
+    WorkerPool& pool = WorkerPool::instance();
+    size_t threads = pool.size() + 1;
+    threads = std::min(threads, std::max<size_t>(1, n / std::max<size_t>(1, minChunk)));
+    if (threads <= 1) {
+        if (n) fn(size_t(0), n);
+        return;
+    }
+
+    size_t chunk = (n + threads - 1) / threads;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t pending = 0;  // counted up front: chunks finish while later ones are still being queued
+    for (size_t t = 1; t < threads; ++t)
+        if (t * chunk < n) ++pending;
+    for (size_t t = 1; t < threads; ++t) {
+        size_t begin = t * chunk, end = std::min(n, begin + chunk);
+        if (begin >= end) continue;
+        pool.submit([&, begin, end] {
+            fn(begin, end);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) done.notify_one();
+        });
+    }
+    fn(size_t(0), std::min(n, chunk));
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending == 0) return;
+        }
+        if (!pool.runOne()) break;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return pending == 0; });
+}
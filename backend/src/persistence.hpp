@@ -0,0 +1,308 @@
+#pragma once
+#include "catalog.hpp"
+#include "models.hpp"
+#include <sqlite3.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Connection settings applied by Persistence::open.
+struct SqliteOptions {
+    bool wal = true;
+    std::string synchronous = "NORMAL";        // OFF, NORMAL, FULL or EXTRA
+    long long mmapSize = 256LL * 1024 * 1024;  // bytes, 0 disables mmap
+    int cacheSize = -65536;                    // pages if positive, KiB if negative
+    int busyTimeoutMs = 5000;
+    size_t readConnections = 4;
+};
+
+// Fixed set of read-only connections. In WAL mode readers see the last
+// committed state and never block, or wait on, the writer connection.
+class ReadPool {
+public:
+    class Lease {
+    public:
+        Lease(ReadPool& pool, sqlite3* db) : pool_(&pool), db_(db) {}
+        Lease(Lease&& other) noexcept : pool_(other.pool_), db_(other.db_) { other.db_ = nullptr; }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { if (db_) pool_->release(db_); }
+
+        sqlite3* get() const { return db_; }
+
+    private:
+        ReadPool* pool_;
+        sqlite3* db_;
+    };
+
+    ReadPool() = default;
+    ReadPool(const ReadPool&) = delete;
+    ReadPool& operator=(const ReadPool&) = delete;
+    ~ReadPool() { close(); }
+
+    bool open(const char* path, const SqliteOptions& options) {
+        for (size_t i = 0; i < options.readConnections; ++i) {
+            sqlite3* db = nullptr;
+            if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+                sqlite3_close(db);
+                return false;
+            }
+            sqlite3_busy_timeout(db, options.busyTimeoutMs);
+            sqlite3_exec(db, ("PRAGMA mmap_size = " + std::to_string(options.mmapSize)).c_str(), 0, 0, 0);
+            sqlite3_exec(db, ("PRAGMA cache_size = " + std::to_string(options.cacheSize)).c_str(), 0, 0, 0);
+            all_.push_back(db);
+            idle_.push_back(db);
+        }
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (sqlite3* db : all_) sqlite3_close(db);
+        all_.clear();
+        idle_.clear();
+    }
+
+    size_t size() const { return all_.size(); }
+
+    // Blocks until a connection is free. The pool must not be empty.
+    Lease acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        available_.wait(lock, [this] { return !idle_.empty(); });
+        sqlite3* db = idle_.back();
+        idle_.pop_back();
+        return Lease(*this, db);
+    }
+
+private:
+    std::vector<sqlite3*> all_;
+    std::vector<sqlite3*> idle_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+
+    void release(sqlite3* db) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle_.push_back(db);
+        }
+        available_.notify_one();
+    }
+};
+
+// Owns the library.db connection and the write statements, which are
+// compiled once in open() and reset/rebound for each call. Every write goes
+// through mutex_, so one Persistence can be shared by all Crow workers.
+class Persistence {
+public:
+    Persistence() = default;
+    Persistence(const Persistence&) = delete;
+    Persistence& operator=(const Persistence&) = delete;
+    ~Persistence() { close(); }
+
+    bool open(const char* path, const SqliteOptions& options = SqliteOptions()) {
+        if (sqlite3_open(path, &db_) != SQLITE_OK) return false;
+
+        sqlite3_busy_timeout(db_, options.busyTimeoutMs);
+        if (options.wal) sqlite3_exec(db_, "PRAGMA journal_mode = WAL", 0, 0, 0);
+        sqlite3_exec(db_, ("PRAGMA synchronous = " + options.synchronous).c_str(), 0, 0, 0);
+        sqlite3_exec(db_, ("PRAGMA mmap_size = " + std::to_string(options.mmapSize)).c_str(), 0, 0, 0);
+        sqlite3_exec(db_, ("PRAGMA cache_size = " + std::to_string(options.cacheSize)).c_str(), 0, 0, 0);
+
+        sqlite3_exec(db_, "CREATE TABLE IF NOT EXISTS books(id INTEGER PRIMARY KEY, title TEXT, author TEXT, isAvailable INTEGER)", 0, 0, 0);
+        sqlite3_exec(db_, "CREATE TABLE IF NOT EXISTS users(userId INTEGER PRIMARY KEY, userName TEXT)", 0, 0, 0);
+        sqlite3_exec(db_, "CREATE TABLE IF NOT EXISTS loans(bookId INTEGER PRIMARY KEY, userId INTEGER, issuedAt INTEGER, dueAt INTEGER)", 0, 0, 0);
+        sqlite3_exec(db_, "CREATE INDEX IF NOT EXISTS loans_by_user ON loans(userId)", 0, 0, 0);
+        sqlite3_exec(db_, "CREATE TABLE IF NOT EXISTS meta(key TEXT PRIMARY KEY, value INTEGER)", 0, 0, 0);
+        sqlite3_exec(db_, "INSERT OR IGNORE INTO meta(key, value) VALUES('generation', 0)", 0, 0, 0);
+
+        // Readers open after the schema exists; read-only connections cannot create it.
+        return readers_.open(path, options) &&
+               prepare(saveBook_, "INSERT OR REPLACE INTO books(id, title, author, isAvailable) VALUES(?, ?, ?, ?)") &&
+               prepare(saveUser_, "INSERT OR REPLACE INTO users(userId, userName) VALUES(?, ?)") &&
+               prepare(deleteBook_, "DELETE FROM books WHERE id = ?") &&
+               prepare(setAvailability_, "UPDATE books SET isAvailable = ? WHERE id = ?") &&
+               prepare(saveLoan_, "INSERT OR REPLACE INTO loans(bookId, userId, issuedAt, dueAt) VALUES(?, ?, ?, ?)") &&
+               prepare(deleteLoan_, "DELETE FROM loans WHERE bookId = ?") &&
+               prepare(bumpGeneration_, "UPDATE meta SET value = value + 1 WHERE key = 'generation'");
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (sqlite3_stmt** stmt : {&saveBook_, &saveUser_, &deleteBook_, &setAvailability_,
+                                     &saveLoan_, &deleteLoan_, &bumpGeneration_}) {
+            sqlite3_finalize(*stmt);
+            *stmt = nullptr;
+        }
+        sqlite3_close(db_);
+        db_ = nullptr;
+        readers_.close();
+    }
+
+    // Why the last call on the writer connection failed, for logs.
+    std::string lastError() const { return db_ ? sqlite3_errmsg(db_) : "cannot allocate connection"; }
+
+    // Read-only connection for queries; returned to the pool when the lease ends.
+    ReadPool::Lease reader() { return readers_.acquire(); }
+
+    // Counter bumped by every committed write batch, so a copy of the data
+    // tagged with it (the binary snapshot) can tell whether it is current.
+    // Writes made to library.db outside this server do not bump it.
+    uint64_t generation() {
+        auto lease = reader();
+        return count(lease.get(), "SELECT value FROM meta WHERE key = 'generation'");
+    }
+
+    bool bumpGeneration() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return run(bumpGeneration_);
+    }
+
+    // Full-table reads for startup, each on its own pooled connection so they
+    // can run concurrently. Rows come back in id order.
+    Catalog loadBooks() {
+        auto lease = reader();
+        Catalog books;
+        books.reserve(count(lease.get(), "SELECT count(*) FROM books"));
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(lease.get(), "SELECT id, title, author, isAvailable FROM books ORDER BY id", -1, &stmt, 0);
+        Book b;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            b.id = sqlite3_column_int(stmt, 0);
+            b.title = columnText(stmt, 1);
+            b.author = columnText(stmt, 2);
+            b.isAvailable = sqlite3_column_int(stmt, 3) != 0;
+            books.push_back(b);
+        }
+        sqlite3_finalize(stmt);
+        return books;
+    }
+
+    std::vector<User> loadUsers() {
+        auto lease = reader();
+        std::vector<User> users;
+        users.reserve(count(lease.get(), "SELECT count(*) FROM users"));
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(lease.get(), "SELECT userId, userName FROM users ORDER BY userId", -1, &stmt, 0);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            User u;
+            u.userId = sqlite3_column_int(stmt, 0);
+            u.userName = columnText(stmt, 1);
+            users.push_back(std::move(u));
+        }
+        sqlite3_finalize(stmt);
+        return users;
+    }
+
+    std::vector<Loan> loadLoans() {
+        auto lease = reader();
+        std::vector<Loan> loans;
+        loans.reserve(count(lease.get(), "SELECT count(*) FROM loans"));
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(lease.get(), "SELECT bookId, userId, issuedAt, dueAt FROM loans ORDER BY bookId", -1, &stmt, 0);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            loans.push_back(Loan{sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1),
+                                 sqlite3_column_int64(stmt, 2), sqlite3_column_int64(stmt, 3)});
+        sqlite3_finalize(stmt);
+        return loans;
+    }
+
+    // Explicit transactions, used by WriteQueue to commit a batch at once.
+    bool begin() { return exec("BEGIN IMMEDIATE"); }
+    bool commit() { return exec("COMMIT"); }
+    bool rollback() { return exec("ROLLBACK"); }
+
+    // A nested savepoint inside the batch transaction, so one group of
+    // mutations can be undone without losing the rest of the batch.
+    bool savepoint() { return exec("SAVEPOINT grp"); }
+    bool releaseSavepoint() { return exec("RELEASE grp"); }
+    bool rollbackToSavepoint() { return exec("ROLLBACK TO grp") && exec("RELEASE grp"); }
+
+    bool saveBook(const Book& b) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_bind_int(saveBook_, 1, b.id);
+        sqlite3_bind_text(saveBook_, 2, b.title.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(saveBook_, 3, b.author.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(saveBook_, 4, b.isAvailable ? 1 : 0);
+        return run(saveBook_);
+    }
+
+    bool saveUser(const User& u) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_bind_int(saveUser_, 1, u.userId);
+        sqlite3_bind_text(saveUser_, 2, u.userName.c_str(), -1, SQLITE_TRANSIENT);
+        return run(saveUser_);
+    }
+
+    bool deleteBook(int id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_bind_int(deleteBook_, 1, id);
+        return run(deleteBook_);
+    }
+
+    bool setBookAvailability(int id, bool available) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_bind_int(setAvailability_, 1, available ? 1 : 0);
+        sqlite3_bind_int(setAvailability_, 2, id);
+        return run(setAvailability_);
+    }
+
+    bool saveLoan(const Loan& l) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_bind_int(saveLoan_, 1, l.bookId);
+        sqlite3_bind_int(saveLoan_, 2, l.userId);
+        sqlite3_bind_int64(saveLoan_, 3, l.issuedAt);
+        sqlite3_bind_int64(saveLoan_, 4, l.dueAt);
+        return run(saveLoan_);
+    }
+
+    bool deleteLoan(int bookId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_bind_int(deleteLoan_, 1, bookId);
+        return run(deleteLoan_);
+    }
+
+private:
+    sqlite3* db_ = nullptr;
+    ReadPool readers_;
+    sqlite3_stmt* saveBook_ = nullptr;
+    sqlite3_stmt* saveUser_ = nullptr;
+    sqlite3_stmt* deleteBook_ = nullptr;
+    sqlite3_stmt* setAvailability_ = nullptr;
+    sqlite3_stmt* saveLoan_ = nullptr;
+    sqlite3_stmt* deleteLoan_ = nullptr;
+    sqlite3_stmt* bumpGeneration_ = nullptr;
+    std::mutex mutex_;
+
+    static size_t count(sqlite3* db, const char* sql) {
+        sqlite3_stmt* stmt;
+        size_t n = 0;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            n = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+        sqlite3_finalize(stmt);
+        return n;
+    }
+
+    // NULL columns read as empty strings.
+    static std::string columnText(sqlite3_stmt* stmt, int col) {
+        const unsigned char* text = sqlite3_column_text(stmt, col);
+        return text ? std::string(reinterpret_cast<const char*>(text), sqlite3_column_bytes(stmt, col)) : std::string();
+    }
+
+    bool exec(const char* sql) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sqlite3_exec(db_, sql, 0, 0, 0) == SQLITE_OK;
+    }
+
+    bool prepare(sqlite3_stmt*& stmt, const char* sql) {
+        return sqlite3_prepare_v2(db_, sql, -1, &stmt, 0) == SQLITE_OK;
+    }
+
+    // Steps a bound statement and returns it to a clean state for the next call.
+    static bool run(sqlite3_stmt* stmt) {
+        bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return ok;
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include "models.hpp"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Which keys a record type reads and how values land in it; one
+// specialization per type RecordParser handles. Fields are bits, 0 for a
+// key the record does not use.
+template <typename T>
+struct RecordFields;
+
+template <>
+struct RecordFields<Book> {
+    static constexpr unsigned Id = 1, Title = 2, Author = 4, Available = 8;
+    static constexpr unsigned required = Id | Title | Author;
+
+    static unsigned field(const std::string& k) {
+        return k == "id" ? Id : k == "title" ? Title : k == "author" ? Author : k == "isAvailable" ? Available : 0;
+    }
+    static void reset(Book& b) { b.isAvailable = true; }
+    static bool integer(Book& b, unsigned f, int v) {
+        if (f != Id) return false;
+        b.id = v;
+        return true;
+    }
+    static bool text(Book& b, unsigned f, std::string& v) {
+        if (f == Title) b.title = std::move(v);
+        else if (f == Author) b.author = std::move(v);
+        else return false;
+        return true;
+    }
+    static bool boolean(Book& b, unsigned f, bool v) {
+        if (f != Available) return false;
+        b.isAvailable = v;
+        return true;
+    }
+};
+
+template <>
+struct RecordFields<User> {
+    static constexpr unsigned UserId = 1, UserName = 2;
+    static constexpr unsigned required = UserId | UserName;
+
+    static unsigned field(const std::string& k) { return k == "userId" ? UserId : k == "userName" ? UserName : 0; }
+    static void reset(User&) {}
+    static bool integer(User& u, unsigned f, int v) {
+        if (f != UserId) return false;
+        u.userId = v;
+        return true;
+    }
+    static bool text(User& u, unsigned f, std::string& v) {
+        if (f != UserName) return false;
+        u.userName = std::move(v);
+        return true;
+    }
+    static bool boolean(User&, unsigned, bool) { return false; }
+};
+
+// Reads records straight off the parser's events, without building a json
+// tree: one record for POST /books and each NDJSON line, or a JSON array of
+// them for a bulk body. Every field a record uses must be present with its
+// type (integers must fit in an int); other keys are skipped, whatever they
+// hold. Of a record's problems the client hears one, in this order: not an
+// object, missing fields, a wrong-typed field. A repeated key counts as its
+// last value.
+template <typename T>
+class RecordParser {
+public:
+    using Fields = RecordFields<T>;
+
+    // False with a message for the client if [first, last) is not a valid record.
+    template <typename Iterator>
+    static bool parse(Iterator first, Iterator last, T& out, std::string& error) {
+        error.clear();
+        RecordParser p(0);
+        p.rec_ = &out;
+        p.error_ = &error;
+        if (!json::sax_parse(first, last, &p)) error = "Invalid JSON";
+        return error.empty();
+    }
+
+    static bool parse(const std::string& body, T& out, std::string& error) {
+        return parse(body.begin(), body.end(), out, error);
+    }
+
+    // A JSON array of records: errors[i] is empty iff records[i] is valid.
+    // False if body is not a JSON array.
+    static bool parseArray(const std::string& body, std::vector<T>& records, std::vector<std::string>& errors) {
+        RecordParser p(1);
+        p.records_ = &records;
+        p.errors_ = &errors;
+        return json::sax_parse(body, &p);
+    }
+
+    // json::sax_parse callbacks.
+    bool null() { return scalar(false); }
+    bool boolean(bool v) { return scalar(inRecord() && Fields::boolean(*rec_, field_, v)); }
+    bool number_integer(int64_t v) {
+        return scalar(inRecord() && v >= INT_MIN && v <= INT_MAX && Fields::integer(*rec_, field_, static_cast<int>(v)));
+    }
+    bool number_unsigned(uint64_t v) {
+        return scalar(inRecord() && v <= static_cast<uint64_t>(INT_MAX) && Fields::integer(*rec_, field_, static_cast<int>(v)));
+    }
+    bool number_float(double, const std::string&) { return scalar(false); }
+    bool string(std::string& v) { return scalar(inRecord() && Fields::text(*rec_, field_, v)); }
+    bool binary(json::binary_t&) { return scalar(false); }
+
+    bool start_object(size_t) { return open(true); }
+    bool end_object() { return close(); }
+    bool start_array(size_t) { return open(false); }
+    bool end_array() { return close(); }
+
+    bool key(std::string& k) {
+        if (depth_ == recordDepth_ + 1) field_ = Fields::field(k);
+        return true;
+    }
+
+    bool parse_error(size_t, const std::string&, const json::exception&) { return false; }
+
+private:
+    int recordDepth_;  // 0 for one record, 1 inside a bulk array
+    int depth_ = 0;
+
+    std::vector<T>* records_ = nullptr;
+    std::vector<std::string>* errors_ = nullptr;
+
+    // The record being read.
+    T* rec_ = nullptr;
+    std::string* error_ = nullptr;
+    bool isObject_ = false;
+    unsigned field_ = 0;
+    unsigned seen_ = 0;
+    unsigned bad_ = 0;
+
+    explicit RecordParser(int recordDepth) : recordDepth_(recordDepth) {}
+
+    // A value of the current field, as opposed to one nested in it.
+    bool inRecord() const { return depth_ == recordDepth_ + 1 && field_ != 0; }
+
+    void begin(bool isObject) {
+        if (records_) {
+            records_->emplace_back();
+            errors_->emplace_back();
+            rec_ = &records_->back();
+            error_ = &errors_->back();
+        }
+        Fields::reset(*rec_);
+        isObject_ = isObject;
+        field_ = seen_ = bad_ = 0;
+    }
+
+    void end() {
+        if (!isObject_) *error_ = "Record is not an object";
+        else if ((seen_ & Fields::required) != Fields::required) *error_ = "Missing fields";
+        else if (bad_) *error_ = "Invalid field type";
+    }
+
+    // A value of the current field; accepted says whether it was stored.
+    void value(bool accepted) {
+        if (depth_ != recordDepth_ + 1 || field_ == 0) return;
+        seen_ |= field_;
+        if (accepted) bad_ &= ~field_;
+        else bad_ |= field_;
+    }
+
+    bool scalar(bool accepted) {
+        if (depth_ < recordDepth_) return false;  // a bulk body that is not an array
+        if (depth_ == recordDepth_) {
+            begin(false);
+            end();
+        } else {
+            value(accepted);
+        }
+        return true;
+    }
+
+    bool open(bool isObject) {
+        if (depth_ < recordDepth_ && isObject) return false;
+        if (depth_ == recordDepth_) begin(isObject);
+        else value(false);
+        ++depth_;
+        return true;
+    }
+
+    bool close() {
+        if (--depth_ == recordDepth_) end();
+        return true;
+    }
+};
+
+using BookParser = RecordParser<Book>;
@@ -0,0 +1,100 @@
+#pragma once
+#include "json.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Bump allocation for request-scoped JSON trees and temporaries, which are
+// built, used once and thrown away. While an arena::Scope is alive on a
+// thread, every arena::Allocator allocation on that thread comes from the
+// scope's monotonic buffer (first from a block on the stack, then from
+// growing heap chunks), individual frees are no-ops, and the whole lot is
+// released when the scope ends. Outside any scope the allocator falls back to new/delete.
+namespace arena {
+
+inline std::pmr::memory_resource*& current() {
+    thread_local std::pmr::memory_resource* resource = std::pmr::new_delete_resource();
+    return resource;
+}
+
+// nlohmann::basic_json only accepts stateless allocators, so each block
+// carries the resource it came from in a small header; a tree may then be
+// freed on the right resource even after the thread has left the scope,
+// as long as the scope itself is still alive.
+template <typename T>
+struct Allocator {
+    using value_type = T;
+
+    Allocator() = default;
+    template <typename U>
+    Allocator(const Allocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        std::pmr::memory_resource* r = current();
+        char* block = static_cast<char*>(r->allocate(kHeader + n * sizeof(T), alignof(std::max_align_t)));
+        *reinterpret_cast<std::pmr::memory_resource**>(block) = r;
+        return reinterpret_cast<T*>(block + kHeader);
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        char* block = reinterpret_cast<char*>(p) - kHeader;
+        std::pmr::memory_resource* r = *reinterpret_cast<std::pmr::memory_resource**>(block);
+        r->deallocate(block, kHeader + n * sizeof(T), alignof(std::max_align_t));
+    }
+
+    template <typename U>
+    bool operator==(const Allocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const Allocator<U>&) const { return false; }
+
+private:
+    static constexpr std::size_t kHeader = alignof(std::max_align_t);
+};
+
+// Makes this thread's arena::Allocator draw from a fresh arena until the
+// scope ends. Declare it before any JSON it should cover, so that JSON is
+// destroyed first. Scopes nest.
+class Scope {
+public:
+    Scope() : buffer_(initial_, sizeof(initial_), std::pmr::new_delete_resource()), previous_(current()) {
+        current() = &buffer_;
+    }
+    ~Scope() { current() = previous_; }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    alignas(std::max_align_t) char initial_[8192];
+    std::pmr::monotonic_buffer_resource buffer_;
+    std::pmr::memory_resource* previous_;
+};
+
+// Request-scoped text and sequences: allocated from the current scope like
+// arena_json nodes, and dropped with it.
+using string = std::basic_string<char, std::char_traits<char>, Allocator<char>>;
+template <typename T>
+using vector = std::vector<T, Allocator<T>>;
+
+}  // namespace arena
+
+// nlohmann::json whose nodes, object keys and string values all come from
+// the current arena::Scope.
+using arena_json = nlohmann::basic_json<std::map, std::vector, arena::string, bool, std::int64_t, std::uint64_t,
+                                        double, arena::Allocator>;
+
+namespace arena {
+
+// The same text as j.dump(), written straight into a std::string (a
+// response body) instead of into Json::string_t and copied out.
+template <typename Json>
+std::string dump(const Json& j) {
+    std::string out;
+    nlohmann::detail::serializer<Json> s(nlohmann::detail::output_adapter<char, std::string>(out), ' ');
+    s.dump(j, false, false, 0);
+    return out;
+}
+
+}  // namespace arena
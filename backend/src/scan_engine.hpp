@@ -0,0 +1,237 @@
+#pragma once
+#include "catalog.hpp"
+#include "id_index.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Substring kernels. Each returns the first occurrence of needle (m >= 2
+// bytes) in [begin, end), or end. The SIMD versions compare the needle's first
+// and last byte against a whole register of candidate positions at once and
+// only memcmp the middle where both agree.
+namespace scan {
+
+inline const char* findScalar(const char* begin, const char* end, const char* needle, size_t m) {
+    if (static_cast<size_t>(end - begin) < m) return end;
+    const char* last = end - m + 1;
+    for (const char* p = begin; p < last;) {
+        p = static_cast<const char*>(std::memchr(p, needle[0], static_cast<size_t>(last - p)));
+        if (!p) return end;
+        if (std::memcmp(p + 1, needle + 1, m - 1) == 0) return p;
+        ++p;
+    }
+    return end;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+inline const char* findSse2(const char* begin, const char* end, const char* needle, size_t m) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    const char* p = begin;
+    for (; static_cast<size_t>(end - p) >= m - 1 + 16; p += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + m - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, a), _mm_cmpeq_epi8(last, b))));
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (std::memcmp(p + bit + 1, needle + 1, m - 2) == 0) return p + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(p, end, needle, m);
+}
+
+__attribute__((target("avx2")))
+inline const char* findAvx2(const char* begin, const char* end, const char* needle, size_t m) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    const char* p = begin;
+    for (; static_cast<size_t>(end - p) >= m - 1 + 32; p += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + m - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, a), _mm256_cmpeq_epi8(last, b))));
+        while (mask) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (std::memcmp(p + bit + 1, needle + 1, m - 2) == 0) return p + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(p, end, needle, m);
+}
+#endif
+
+using FindFn = const char* (*)(const char*, const char*, const char*, size_t);
+
+struct Kernel {
+    FindFn find;
+    const char* name;
+};
+
+// Picked once from what the CPU supports.
+inline const Kernel& kernel() {
+    static const Kernel k = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return Kernel{findAvx2, "avx2"};
+        if (__builtin_cpu_supports("sse2")) return Kernel{findSse2, "sse2"};
+#endif
+        return Kernel{findScalar, "scalar"};
+    }();
+    return k;
+}
+
+inline void foldCase(std::string& s) {
+    for (auto& c : s)
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+}
+
+}  // namespace scan
+
+// Case-insensitive substring filter over titles and authors for queries the
+// token indexes cannot answer (any infix, across word boundaries). Titles
+// are one contiguous, lowercased byte arena with rows separated by '\0', so a
+// scan is a single kernel pass per thread instead of a find() per Book.
+// Deleted rows stay in the arena as dead rows until they make up a quarter of
+// it, then the arena is compacted. Authors are not copied: the catalog's
+// author pool holds each name once, so a scan matches the distinct names and
+// then picks the books by author id.
+class ScanEngine {
+public:
+    enum Field { Title = 1, Author = 2, Any = 3 };
+
+    void add(int id, const std::string& title) {
+        remove(id);
+        rows_.put(id, ids_.size());
+        ids_.push_back(id);
+        append(title_, title);
+    }
+
+    void remove(int id) {
+        size_t row = rows_.find(id);
+        if (row == IdIndex::npos) return;
+        rows_.erase(id);
+        ids_[row] = kDead;
+        if (++dead_ > 1024 && dead_ * 4 > ids_.size()) compact();
+    }
+
+    // Ids of books whose field(s) contain needle, ascending, at most limit;
+    // total receives the full count. books must hold the same books.
+    std::vector<int> scan(const Catalog& books, const std::string& needle, Field field, size_t limit, size_t& total) const {
+        std::string folded = needle;
+        scan::foldCase(folded);
+        std::vector<int> out;
+        if (field & Title) {
+            std::vector<char> hit(ids_.size(), 0);
+            mark(title_, folded, hit);
+            for (size_t row = 0; row < hit.size(); ++row)
+                if (hit[row] && ids_[row] != kDead) out.push_back(ids_[row]);
+        }
+        if (field & Author) {
+            std::vector<char> hit(books.authorIdLimit(), 0);
+            std::string name;
+            for (uint32_t a = 0; a < hit.size(); ++a) {
+                if (!books.authorBooks(a)) continue;
+                name = books.authorName(a);
+                scan::foldCase(name);
+                hit[a] = contains(name, folded);
+            }
+            for (size_t slot = 0; slot < books.size(); ++slot)
+                if (hit[books.authorId(slot)]) out.push_back(books.id(slot));
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        total = out.size();
+        if (out.size() > limit) out.resize(limit);
+        return out;
+    }
+
+    static const char* kernelName() { return scan::kernel().name; }
+
+private:
+    static constexpr int kDead = INT32_MIN;
+
+    struct Column {
+        std::string bytes;             // rows, lowercased, each followed by '\0'
+        std::vector<uint64_t> starts;  // row -> offset of its first byte
+    };
+
+    Column title_;
+    std::vector<int> ids_;  // row -> book id, kDead once removed
+    IdIndex rows_;          // book id -> live row
+    size_t dead_ = 0;
+
+    static void append(Column& c, const std::string& text) {
+        c.starts.push_back(c.bytes.size());
+        size_t at = c.bytes.size();
+        c.bytes.append(text);
+        for (size_t i = at; i < c.bytes.size(); ++i)
+            if (c.bytes[i] >= 'A' && c.bytes[i] <= 'Z') c.bytes[i] = static_cast<char>(c.bytes[i] - 'A' + 'a');
+        c.bytes += '\0';
+    }
+
+    void compact() {
+        Column title;
+        std::vector<int> ids;
+        ids.reserve(ids_.size() - dead_);
+        rows_.clear();
+        for (size_t row = 0; row < ids_.size(); ++row) {
+            if (ids_[row] == kDead) continue;
+            rows_.put(ids_[row], ids.size());
+            ids.push_back(ids_[row]);
+            copyRow(title_, row, title);
+        }
+        title_ = std::move(title);
+        ids_ = std::move(ids);
+        dead_ = 0;
+    }
+
+    static void copyRow(const Column& from, size_t row, Column& to) {
+        to.starts.push_back(to.bytes.size());
+        to.bytes.append(from.bytes, from.starts[row], end(from, row) - from.starts[row]);
+    }
+
+    static uint64_t end(const Column& c, size_t row) {
+        return row + 1 < c.starts.size() ? c.starts[row + 1] : c.bytes.size();
+    }
+
+    static bool contains(const std::string& text, const std::string& needle) {
+        if (needle.empty()) return true;
+        const char* end = text.data() + text.size();
+        const char* found = needle.size() == 1 ? static_cast<const char*>(std::memchr(text.data(), needle[0], text.size()))
+                                               : scan::kernel().find(text.data(), end, needle.data(), needle.size());
+        return found && found != end;
+    }
+
+    // Sets hit[row] for every row of c containing needle. Rows are split
+    // into contiguous ranges, one per core, and each range is one byte span.
+    static void mark(const Column& c, const std::string& needle, std::vector<char>& hit) {
+        if (needle.empty()) {
+            std::fill(hit.begin(), hit.end(), 1);
+            return;
+        }
+        const scan::Kernel& k = scan::kernel();
+        const char* base = c.bytes.data();
+        parallelFor(c.starts.size(), 4096, [&](size_t r0, size_t r1) {
+            const char* p = base + c.starts[r0];
+            const char* stop = base + end(c, r1 - 1);
+            while (p < stop) {
+                const char* found = needle.size() == 1
+                    ? static_cast<const char*>(std::memchr(p, needle[0], static_cast<size_t>(stop - p)))
+                    : k.find(p, stop, needle.data(), needle.size());
+                if (!found || found >= stop) break;
+                uint64_t offset = static_cast<uint64_t>(found - base);
+                size_t row = static_cast<size_t>(
+                    std::upper_bound(c.starts.begin() + r0, c.starts.begin() + r1, offset) - c.starts.begin() - 1);
+                hit[row] = 1;
+                p = base + end(c, row);  // one hit per row is enough
+            }
+        });
+    }
+};
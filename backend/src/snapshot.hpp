@@ -0,0 +1,246 @@
+#pragma once
+#include "catalog.hpp"
+#include "models.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary image of the catalog, used to skip the SQLite load on restart.
+//
+// Layout (host byte order):
+//   header:  magic "LIBSNAP1", u32 format, u32 reserved, u64 generation,
+//            u64 bookCount, u64 userCount, u64 payloadBytes, u64 checksum
+//   payload: books as i32 id, u8 isAvailable, u32 len + title, u32 len + author
+//            users as i32 userId, u32 len + userName
+//
+// generation is the library.db generation (see Persistence::generation) the
+// catalog was captured at; a snapshot from any other generation is stale.
+namespace snapshot {
+
+constexpr char kMagic[8] = {'L', 'I', 'B', 'S', 'N', 'A', 'P', '1'};
+constexpr uint32_t kFormat = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t generation;
+    uint64_t bookCount;
+    uint64_t userCount;
+    uint64_t payloadBytes;
+    uint64_t checksum;
+};
+
+// Word-at-a-time multiply/rotate hash; catches truncation and bit rot.
+inline uint64_t checksum(const char* data, size_t len) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = len * k;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = (h ^ (w * k)) * 0xC2B2AE3D27D4EB4Full;
+        h = (h << 31) | (h >> 33);
+    }
+    for (; i < len; ++i) h = (h ^ static_cast<unsigned char>(data[i])) * k;
+    return h ^ (h >> 29);
+}
+
+inline void putU32(std::string& out, uint32_t v) { out.append(reinterpret_cast<const char*>(&v), 4); }
+
+inline void putString(std::string& out, std::string_view s) {
+    putU32(out, static_cast<uint32_t>(s.size()));
+    out += s;
+}
+
+inline std::string encode(uint64_t generation, const Catalog& books, const std::vector<User>& users) {
+    std::string payload;
+    size_t estimate = 0;
+    for (size_t i = 0; i < books.size(); ++i) estimate += 13 + books.title(i).size() + books.author(i).size();
+    for (const auto& u : users) estimate += 8 + u.userName.size();
+    payload.reserve(estimate);
+
+    for (size_t i = 0; i < books.size(); ++i) {
+        putU32(payload, static_cast<uint32_t>(books.id(i)));
+        payload += static_cast<char>(books.isAvailable(i) ? 1 : 0);
+        putString(payload, books.title(i));
+        putString(payload, books.author(i));
+    }
+    for (const auto& u : users) {
+        putU32(payload, static_cast<uint32_t>(u.userId));
+        putString(payload, u.userName);
+    }
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.format = kFormat;
+    h.generation = generation;
+    h.bookCount = books.size();
+    h.userCount = users.size();
+    h.payloadBytes = payload.size();
+    h.checksum = checksum(payload.data(), payload.size());
+
+    std::string out(reinterpret_cast<const char*>(&h), sizeof(h));
+    out += payload;
+    return out;
+}
+
+// Writes to a temporary file and renames it over path, so a crash mid-write
+// leaves the previous snapshot intact.
+inline bool writeFile(const std::string& path, const std::string& bytes) {
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    ok = std::fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Bounds-checked reader over the mapped payload.
+class Cursor {
+public:
+    Cursor(const char* p, const char* end) : p_(p), end_(end) {}
+
+    bool u32(uint32_t& v) {
+        if (end_ - p_ < 4) return false;
+        std::memcpy(&v, p_, 4);
+        p_ += 4;
+        return true;
+    }
+
+    bool u8(uint8_t& v) {
+        if (p_ == end_) return false;
+        v = static_cast<uint8_t>(*p_++);
+        return true;
+    }
+
+    bool str(std::string& s) {
+        uint32_t len;
+        if (!u32(len) || static_cast<size_t>(end_ - p_) < len) return false;
+        s.assign(p_, len);
+        p_ += len;
+        return true;
+    }
+
+    bool atEnd() const { return p_ == end_; }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+// Maps path and decodes it if it was captured at expectedGeneration.
+// On false, why says whether the file was missing, stale or corrupt.
+inline bool read(const std::string& path, uint64_t expectedGeneration, Catalog& books,
+                 std::vector<User>& users, std::string& why) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { why = "missing"; return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        why = "corrupt";
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) { why = "unreadable"; return false; }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(map);
+    Header h;
+    std::memcpy(&h, base, sizeof(h));
+    bool ok = false;
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.format != kFormat ||
+        h.payloadBytes != size - sizeof(Header)) {
+        why = "corrupt";
+    } else if (h.generation != expectedGeneration) {
+        why = "stale";
+    } else if (h.bookCount > h.payloadBytes / 13 || h.userCount > h.payloadBytes / 8 ||
+               checksum(base + sizeof(Header), h.payloadBytes) != h.checksum) {
+        why = "corrupt";
+    } else {
+        Cursor c(base + sizeof(Header), base + size);
+        books = Catalog();
+        books.reserve(h.bookCount);
+        users.assign(h.userCount, User{});
+        ok = true;
+        Book b;
+        for (uint64_t i = 0; i < h.bookCount; ++i) {
+            uint32_t id;
+            uint8_t available;
+            if (!(c.u32(id) && c.u8(available) && c.str(b.title) && c.str(b.author))) { ok = false; break; }
+            b.id = static_cast<int>(id);
+            b.isAvailable = available != 0;
+            books.push_back(b);
+        }
+        for (size_t i = 0; ok && i < users.size(); ++i) {
+            uint32_t id;
+            if (!(c.u32(id) && c.str(users[i].userName))) { ok = false; break; }
+            users[i].userId = static_cast<int>(id);
+        }
+        ok = ok && c.atEnd();
+        if (!ok) {
+            why = "corrupt";
+            books = Catalog();
+            users.clear();
+        }
+    }
+    munmap(map, size);
+    return ok;
+}
+
+}  // namespace snapshot
+
+// Runs a task on its own thread every interval until stopped.
+class PeriodicTask {
+public:
+    PeriodicTask() = default;
+    PeriodicTask(const PeriodicTask&) = delete;
+    PeriodicTask& operator=(const PeriodicTask&) = delete;
+    ~PeriodicTask() { stop(); }
+
+    void start(std::chrono::seconds interval, std::function<void()> task) {
+        stopping_ = false;
+        worker_ = std::thread([this, interval, task] {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!wake_.wait_for(lock, interval, [this] { return stopping_; })) {
+                lock.unlock();
+                task();
+                lock.lock();
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+private:
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,167 @@
+#pragma once
+#include "catalog.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <string_view>
+#include <vector>
+
+// Ordered secondary indexes over the catalog. Each set iterates books in
+// the order a listing needs, with the id as tiebreaker so every key is
+// unique and keyset paging stays stable. Every order is kept twice, once
+// for available and once for issued books, so an availability filter is a
+// choice of set rather than a per-book check; a listing of both merges the
+// two. Within one author, byAuthor is in id order and byAuthorTitle in
+// title order, so an author filter seeks straight to its run either way.
+//
+// The title and author orders hold catalog slots and compare through the
+// catalog's columns, so no title or author is copied out of it. A slot's
+// entries must therefore be removed before its row is replaced or moved
+// and added back afterwards.
+class BookOrderIndexes {
+public:
+    // Probes for lower_bound/upper_bound.
+    struct Key {
+        std::string_view text;  // title for byTitle, author for byAuthor
+        int id;
+    };
+    struct AuthorTitleKey {
+        std::string_view author;
+        std::string_view title;
+        int id;
+    };
+
+    struct TitleOrder {
+        using is_transparent = void;
+        const Catalog* books;
+        bool operator()(size_t a, size_t b) const { return less(books->title(a), books->id(a), books->title(b), books->id(b)); }
+        bool operator()(size_t a, const Key& k) const { return less(books->title(a), books->id(a), k.text, k.id); }
+        bool operator()(const Key& k, size_t b) const { return less(k.text, k.id, books->title(b), books->id(b)); }
+    };
+
+    struct AuthorOrder {
+        using is_transparent = void;
+        const Catalog* books;
+        bool operator()(size_t a, size_t b) const {
+            if (books->authorId(a) == books->authorId(b)) return books->id(a) < books->id(b);
+            return books->author(a) < books->author(b);
+        }
+        bool operator()(size_t a, const Key& k) const { return less(books->author(a), books->id(a), k.text, k.id); }
+        bool operator()(const Key& k, size_t b) const { return less(k.text, k.id, books->author(b), books->id(b)); }
+    };
+
+    struct AuthorTitleOrder {
+        using is_transparent = void;
+        const Catalog* books;
+        bool operator()(size_t a, size_t b) const {
+            if (books->authorId(a) != books->authorId(b)) return books->author(a) < books->author(b);
+            return less(books->title(a), books->id(a), books->title(b), books->id(b));
+        }
+        bool operator()(size_t a, const AuthorTitleKey& k) const {
+            int c = std::string_view(books->author(a)).compare(k.author);
+            return c != 0 ? c < 0 : less(books->title(a), books->id(a), k.title, k.id);
+        }
+        bool operator()(const AuthorTitleKey& k, size_t b) const {
+            int c = k.author.compare(books->author(b));
+            return c != 0 ? c < 0 : less(k.title, k.id, books->title(b), books->id(b));
+        }
+    };
+
+    // One availability's books in every order.
+    struct Orders {
+        std::set<int> byId;
+        std::set<size_t, TitleOrder> byTitle;                // catalog slots
+        std::set<size_t, AuthorOrder> byAuthor;              // catalog slots
+        std::set<size_t, AuthorTitleOrder> byAuthorTitle;  // catalog slots
+
+        explicit Orders(const Catalog& books)
+            : byTitle(TitleOrder{&books}), byAuthor(AuthorOrder{&books}), byAuthorTitle(AuthorTitleOrder{&books}) {}
+    };
+
+    Orders available;
+    Orders issued;
+
+    explicit BookOrderIndexes(const Catalog& books) : available(books), issued(books), books_(books) {}
+
+    void add(size_t slot) { insert(books_.isAvailable(slot) ? available : issued, slot); }
+
+    // Adds every book in the catalog to empty indexes, as the startup load
+    // does. Each order is sorted once as a vector and appended with end()
+    // hints, amortized O(1) per insert instead of a descent per book. Titles
+    // are compared once, for all orders and both sides, and authors once per
+    // distinct author; the per-order sorts then compare ranks.
+    void build() {
+        std::vector<size_t> slots(books_.size());
+        for (size_t i = 0; i < slots.size(); ++i) slots[i] = i;
+
+        std::vector<uint32_t> authorRank(books_.authorIdLimit());
+        {
+            std::vector<uint32_t> authors;
+            for (uint32_t a = 0; a < books_.authorIdLimit(); ++a)
+                if (books_.authorBooks(a)) authors.push_back(a);
+            std::sort(authors.begin(), authors.end(),
+                      [this](uint32_t a, uint32_t b) { return books_.authorName(a) < books_.authorName(b); });
+            for (uint32_t r = 0; r < authors.size(); ++r) authorRank[authors[r]] = r;
+        }
+        std::sort(slots.begin(), slots.end(), TitleOrder{&books_});
+        std::vector<uint32_t> titleRank(books_.size());
+        for (uint32_t r = 0; r < slots.size(); ++r) titleRank[slots[r]] = r;
+
+        appendAll(slots, &Orders::byTitle);
+        std::sort(slots.begin(), slots.end(), [&](size_t a, size_t b) {
+            uint32_t x = authorRank[books_.authorId(a)], y = authorRank[books_.authorId(b)];
+            return x != y ? x < y : titleRank[a] < titleRank[b];
+        });
+        appendAll(slots, &Orders::byAuthorTitle);
+        std::sort(slots.begin(), slots.end(), [&](size_t a, size_t b) {
+            uint32_t x = authorRank[books_.authorId(a)], y = authorRank[books_.authorId(b)];
+            return x != y ? x < y : books_.id(a) < books_.id(b);
+        });
+        appendAll(slots, &Orders::byAuthor);
+        std::sort(slots.begin(), slots.end(), [this](size_t a, size_t b) { return books_.id(a) < books_.id(b); });
+        for (size_t slot : slots) {
+            auto& byId = (books_.isAvailable(slot) ? available : issued).byId;
+            byId.insert(byId.end(), books_.id(slot));
+        }
+    }
+
+    void remove(size_t slot) { erase(books_.isAvailable(slot) ? available : issued, slot); }
+
+    // Moves slot to the isAvailable side, whether or not the catalog has
+    // been flipped yet; none of the orders compare availability.
+    void setAvailable(size_t slot, bool isAvailable) {
+        erase(isAvailable ? issued : available, slot);
+        insert(isAvailable ? available : issued, slot);
+    }
+
+private:
+    const Catalog& books_;
+
+    static bool less(std::string_view a, int aId, std::string_view b, int bId) {
+        int c = a.compare(b);
+        return c != 0 ? c < 0 : aId < bId;
+    }
+
+    // Appends the slots, already in the set's order, each to its side's set.
+    template <typename Set>
+    void appendAll(const std::vector<size_t>& slots, Set Orders::*set) {
+        for (size_t slot : slots) {
+            Set& s = (books_.isAvailable(slot) ? available : issued).*set;
+            s.insert(s.end(), slot);
+        }
+    }
+
+    void insert(Orders& o, size_t slot) {
+        o.byId.insert(books_.id(slot));
+        o.byTitle.insert(slot);
+        o.byAuthor.insert(slot);
+        o.byAuthorTitle.insert(slot);
+    }
+
+    void erase(Orders& o, size_t slot) {
+        o.byId.erase(books_.id(slot));
+        o.byTitle.erase(slot);
+        o.byAuthor.erase(slot);
+        o.byAuthorTitle.erase(slot);
+    }
+};
@@ -0,0 +1,650 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Prefix autocomplete over book titles, authors and user names.
+//
+// Each distinct (kind, text) is one entry, weighted by how many records carry
+// it. An entry is found under its lowercased text and under the suffixes
+// starting at each of its first few later words, so "tolk" finds
+// "J. R. R. Tolkien". A key is just (entry, offset into its text), and entry
+// texts sit back to back in one arena, so the keys under a prefix are a
+// contiguous run in key order. The keys live in a B+tree whose every node
+// caches its best kCache entries: a prefix's best entries come from the
+// cached nodes wholly inside its run plus the keys of the two leaves at its
+// ends.
+//
+// Changes are queued until refresh(). A few new keys are inserted into the
+// tree one by one, each offered to the nodes above it; a weight change
+// re-ranks only the nodes that ranked the entry. A batch of new keys large
+// against the tree (the startup load) rebuilds it instead, with one sort done
+// eight bytes at a time on cached key heads.
+//
+// Not synchronized: changes and refresh() need the caller's exclusive lock,
+// and suggest() only reads, so lookups can run in parallel under a shared
+// one. A batch of changes can share one refresh(), but lookups must not run
+// between a change and the next refresh().
+class SuggestIndex {
+public:
+    enum Kind : uint8_t { Title, Author, UserName };
+
+    struct Suggestion {
+        std::string text;
+        Kind kind;
+        uint32_t weight;
+    };
+
+    static constexpr size_t kCache = 10;
+
+    void add(Kind kind, const std::string& text) {
+        if (text.empty()) return;
+        uint32_t e = find(kind, text);
+        if (e != kNone) {
+            ++entries_[e].weight;
+            if (e < treeEntries_) raised_.push_back(e);
+            return;
+        }
+        e = static_cast<uint32_t>(entries_.size());
+        entries_.push_back(Entry{static_cast<uint32_t>(text_.size()), static_cast<uint32_t>(text.size()), 1, kind});
+        text_ += text;
+        insertId(e);
+        for (uint32_t start : starts(e)) pending_.push_back(Key{e, start});
+    }
+
+    void remove(Kind kind, const std::string& text) {
+        if (text.empty()) return;
+        uint32_t e = find(kind, text);
+        if (e == kNone) return;
+        if (--entries_[e].weight == 0) {
+            eraseId(e);
+            ++deadEntries_;
+        }
+        if (e < treeEntries_) {
+            lowered_.push_back(e);
+        } else if (entries_[e].weight == 0) {
+            pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [e](const Key& k) { return k.entry == e; }),
+                           pending_.end());
+        }
+    }
+
+    // Brings lookups up to date with every change since the last refresh.
+    void refresh() {
+        if (inner_.empty() || pending_.size() > std::max(kMinRebuild, treeKeys_ / 16) ||
+            deadEntries_ * 4 > entries_.size() + kMinRebuild) {
+            rebuild();
+            return;
+        }
+        rerank();
+        sortKeys(pending_.begin(), pending_.end());  // neighbours share their way down
+        std::vector<Step> path;
+        for (const Key& k : pending_) insertKey(k, path);
+        treeKeys_ += pending_.size();
+        pending_.clear();
+        treeEntries_ = static_cast<uint32_t>(entries_.size());
+    }
+
+    // Up to k (at most kCache) entries under prefix, heaviest first.
+    std::vector<Suggestion> suggest(const std::string& prefix, size_t k) const {
+        std::string key = normalize(prefix);
+        Top best;
+        if (!inner_.empty()) collect(root_, height_, false, false, key, best);
+
+        std::vector<Suggestion> out;
+        for (size_t i = 0; i < best.count && out.size() < k; ++i) {
+            const Entry& en = entries_[best.ids[i]];
+            out.push_back(Suggestion{text_.substr(en.offset, en.length), en.kind, en.weight});
+        }
+        return out;
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+    static constexpr uint32_t kErased = UINT32_MAX - 1;  // tombstone in table_
+    static constexpr size_t kMaxWordKeys = 4;
+    static constexpr size_t kLeafMax = 128;     // a leaf that fills splits in two
+    static constexpr size_t kLeafFill = 96;     // keys per leaf when rebuilt, leaving room to insert
+    static constexpr size_t kFanout = 16;       // an inner node that fills splits in two
+    static constexpr size_t kFanoutFill = 12;
+    static constexpr size_t kMinRebuild = 4096;
+
+    struct Entry {
+        uint32_t offset;  // into text_
+        uint32_t length;
+        uint32_t weight;  // 0 once removed
+        Kind kind;
+    };
+
+    // The entry's text from start, lowercased, is the key.
+    struct Key {
+        uint32_t entry;
+        uint32_t start;
+    };
+
+    // Best entries first.
+    struct Top {
+        uint32_t ids[kCache];
+        uint8_t count = 0;
+    };
+
+    struct Leaf {
+        Top top;
+        uint32_t count = 0;
+        Key keys[kLeafMax];  // sorted
+    };
+
+    struct Inner {
+        Top top;
+        uint32_t level = 1;  // 1: the children are leaves
+        uint32_t count = 0;
+        uint32_t child[kFanout];
+        Key sep[kFanout];    // child i holds the keys from sep[i] up to sep[i + 1]; sep[0] is unused
+        uint64_t sepHead[kFanout];  // head(sep[i], 0), so most steps down skip the text arena
+    };
+
+    // One inner node on the way down to a leaf, and the child taken.
+    struct Step {
+        uint32_t node;
+        uint32_t pos;
+    };
+
+    std::string text_;              // entry texts back to back; removed ones stay until rebuild() compacts
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> table_;   // open addressing (kind, text) -> live entry
+    size_t tableUsed_ = 0;          // live entries and tombstones
+    size_t deadEntries_ = 0;
+
+    std::vector<Leaf> leaves_;
+    std::vector<Inner> inner_;      // empty until the first refresh()
+    uint32_t root_ = 0;             // in inner_
+    uint32_t height_ = 0;           // inner levels
+    size_t treeKeys_ = 0;
+    uint32_t treeEntries_ = 0;      // entries below this have their keys in the tree
+    std::vector<Key> pending_;      // keys of newer entries, inserted at refresh()
+    std::vector<uint32_t> raised_;  // tree entries whose weight went up since refresh()
+    std::vector<uint32_t> lowered_; // and down, or to 0
+
+    static bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+    }
+
+    static unsigned char lower(unsigned char c) { return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c; }
+
+    static std::string normalize(const std::string& text) {
+        std::string out;
+        out.reserve(text.size());
+        for (unsigned char c : text) out += static_cast<char>(lower(c));
+        size_t start = out.find_first_not_of(' ');
+        return start == std::string::npos ? std::string() : out.substr(start);
+    }
+
+    // Where the entry's keys start: its text past leading spaces, then its
+    // next few words.
+    std::vector<uint32_t> starts(uint32_t e) const {
+        const char* s = text_.data() + entries_[e].offset;
+        uint32_t n = entries_[e].length, first = 0;
+        while (first < n && s[first] == ' ') ++first;
+        std::vector<uint32_t> out{first};
+        for (uint32_t i = first + 1; i < n && out.size() <= kMaxWordKeys; ++i)
+            if (isWordByte(static_cast<unsigned char>(s[i])) && !isWordByte(static_cast<unsigned char>(s[i - 1])))
+                out.push_back(i);
+        return out;
+    }
+
+    std::string_view keyText(const Key& k) const {
+        const Entry& en = entries_[k.entry];
+        return std::string_view(text_.data() + en.offset + k.start, en.length - k.start);
+    }
+
+    // Compares at most limit bytes of a's key with p (already lowercase).
+    int compare(const Key& a, const std::string& p, size_t limit) const {
+        std::string_view t = keyText(a);
+        size_t n = std::min({t.size(), p.size(), limit});
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char x = lower(static_cast<unsigned char>(t[i])), y = static_cast<unsigned char>(p[i]);
+            if (x != y) return x < y ? -1 : 1;
+        }
+        size_t tn = std::min(t.size(), limit), pn = std::min(p.size(), limit);
+        return tn == pn ? 0 : tn < pn ? -1 : 1;
+    }
+
+    bool keyLess(const Key& a, const Key& b) const {
+        std::string_view x = keyText(a), y = keyText(b);
+        size_t n = std::min(x.size(), y.size());
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char cx = lower(static_cast<unsigned char>(x[i])), cy = lower(static_cast<unsigned char>(y[i]));
+            if (cx != cy) return cx < cy;
+        }
+        return x.size() != y.size() ? x.size() < y.size() : a.entry != b.entry ? a.entry < b.entry : a.start < b.start;
+    }
+
+    // Eight bytes of k's key from depth on, lowercased and zero-padded, as
+    // one integer that orders like the bytes.
+    uint64_t head(const Key& k, size_t depth) const {
+        std::string_view t = keyText(k);
+        uint64_t h = 0;
+        for (size_t i = depth; i < depth + 8; ++i) h = h << 8 | (i < t.size() ? lower(static_cast<unsigned char>(t[i])) : 0);
+        return h;
+    }
+
+    // Sorts by keyLess, eight bytes at a time: keys are sorted on a cached
+    // head, and only runs with equal heads read their next eight bytes from
+    // the arena, so the startup load's millions of keys cost a few passes
+    // over the text rather than a string comparison per sort step.
+    void sortKeys(std::vector<Key>::iterator first, std::vector<Key>::iterator last) const {
+        struct Item {
+            uint64_t head;
+            Key key;
+        };
+        struct Run {
+            size_t begin, end, depth;
+        };
+        std::vector<Item> items;
+        items.reserve(static_cast<size_t>(last - first));
+        for (auto it = first; it != last; ++it) items.push_back(Item{head(*it, 0), *it});
+        std::vector<Run> todo{{0, items.size(), 0}};
+        while (!todo.empty()) {
+            Run r = todo.back();
+            todo.pop_back();
+            std::sort(items.begin() + static_cast<std::ptrdiff_t>(r.begin), items.begin() + static_cast<std::ptrdiff_t>(r.end),
+                      [](const Item& a, const Item& b) { return a.head < b.head; });
+            for (size_t i = r.begin, j; i < r.end; i = j) {
+                for (j = i + 1; j < r.end && items[j].head == items[i].head;) ++j;
+                if (j - i < 2) continue;
+                // A key that ends within these eight bytes ties on padding; that run goes to keyLess.
+                bool deeper = std::all_of(items.begin() + static_cast<std::ptrdiff_t>(i), items.begin() + static_cast<std::ptrdiff_t>(j),
+                                          [&](const Item& it) { return keyText(it.key).size() > r.depth + 8; });
+                if (!deeper) {
+                    std::sort(items.begin() + static_cast<std::ptrdiff_t>(i), items.begin() + static_cast<std::ptrdiff_t>(j),
+                              [this](const Item& a, const Item& b) { return keyLess(a.key, b.key); });
+                    continue;
+                }
+                for (size_t m = i; m < j; ++m) items[m].head = head(items[m].key, r.depth + 8);
+                todo.push_back(Run{i, j, r.depth + 8});
+            }
+        }
+        for (const Item& it : items) *first++ = it.key;
+    }
+
+    bool better(uint32_t a, uint32_t b) const {
+        const Entry& x = entries_[a];
+        const Entry& y = entries_[b];
+        if (x.weight != y.weight) return x.weight > y.weight;
+        int c = std::string_view(text_.data() + x.offset, x.length).compare(std::string_view(text_.data() + y.offset, y.length));
+        if (c != 0) return c < 0;
+        return x.kind != y.kind ? x.kind < y.kind : a < b;
+    }
+
+    // Adds live entry e to t unless it is there already or ranks below all kCache.
+    void offer(Top& t, uint32_t e) const {
+        if (entries_[e].weight == 0) return;
+        for (size_t i = 0; i < t.count; ++i)
+            if (t.ids[i] == e) return;
+        if (t.count == kCache && !better(e, t.ids[kCache - 1])) return;
+        size_t at = t.count < kCache ? t.count++ : kCache - 1;
+        for (; at > 0 && better(e, t.ids[at - 1]); --at) t.ids[at] = t.ids[at - 1];
+        t.ids[at] = e;
+    }
+
+    void offerAll(Top& t, const Top& from) const {
+        for (size_t i = 0; i < from.count; ++i) offer(t, from.ids[i]);
+    }
+
+    const Top& childTop(const Inner& n, size_t i) const {
+        return n.level == 1 ? leaves_[n.child[i]].top : inner_[n.child[i]].top;
+    }
+
+    void rankLeaf(uint32_t leaf) {
+        Top t;
+        const Leaf& l = leaves_[leaf];
+        for (size_t i = 0; i < l.count; ++i) offer(t, l.keys[i].entry);
+        leaves_[leaf].top = t;
+    }
+
+    void rankInner(uint32_t node) {
+        Top t;
+        const Inner& n = inner_[node];
+        for (size_t i = 0; i < n.count; ++i) offerAll(t, childTop(n, i));
+        inner_[node].top = t;
+    }
+
+    // Offers the entries under node whose keys have prefix p to best. lowIn
+    // and highIn: the node's bounds are known to lie within p's run, so
+    // wholly inside it when both do.
+    void collect(uint32_t node, uint32_t level, bool lowIn, bool highIn, const std::string& p, Top& best) const {
+        auto before = [&](const Key& k) { return compare(k, p, p.size()) < 0; };
+        auto notAfter = [&](const Key& k) { return compare(k, p, p.size()) <= 0; };
+        if (level == 0) {
+            const Leaf& l = leaves_[node];
+            const Key* lo = std::partition_point(l.keys, l.keys + l.count, before);
+            const Key* hi = std::partition_point(lo, l.keys + l.count, notAfter);
+            for (; lo < hi; ++lo) offer(best, lo->entry);
+            return;
+        }
+        // Children a..b overlap the run; those strictly between lie inside it.
+        const Inner& n = inner_[node];
+        size_t a = static_cast<size_t>(std::partition_point(n.sep + 1, n.sep + n.count, before) - (n.sep + 1));
+        size_t b = static_cast<size_t>(std::partition_point(n.sep + 1, n.sep + n.count, notAfter) - (n.sep + 1));
+        for (size_t i = a; i <= b; ++i) {
+            bool lo = i > a || lowIn;
+            bool hi = i < b || (highIn && b == n.count - 1);
+            if (i == a && a > 0) lo = false;
+            if (lo && hi) offerAll(best, childTop(n, i));
+            else collect(n.child[i], level - 1, lo, hi, p, best);
+        }
+    }
+
+    // The leaf that holds (or would hold) k, and the inner nodes above it, root first.
+    uint32_t descend(const Key& k, std::vector<Step>& path) const {
+        uint64_t h = head(k, 0);
+        path.clear();
+        uint32_t node = root_;
+        for (uint32_t level = height_; level > 0; --level) {
+            const Inner& n = inner_[node];
+            uint32_t lo = 1, hi = n.count;  // first sep above k
+            while (lo < hi) {
+                uint32_t mid = (lo + hi) / 2;
+                if (h < n.sepHead[mid] || (h == n.sepHead[mid] && keyLess(k, n.sep[mid]))) hi = mid;
+                else lo = mid + 1;
+            }
+            path.push_back(Step{node, lo - 1});
+            node = n.child[lo - 1];
+        }
+        return node;
+    }
+
+    void insertKey(const Key& k, std::vector<Step>& path) {
+        uint32_t leaf = descend(k, path);
+        Leaf& l = leaves_[leaf];
+        Key* at = std::upper_bound(l.keys, l.keys + l.count, k, [this](const Key& a, const Key& b) { return keyLess(a, b); });
+        std::copy_backward(at, l.keys + l.count, l.keys + l.count + 1);
+        *at = k;
+        ++l.count;
+        offer(l.top, k.entry);
+        for (const Step& s : path) offer(inner_[s.node].top, k.entry);
+        if (l.count == kLeafMax) split(leaf, path);
+    }
+
+    // Splits a full leaf in two and hands the new half up to its parent,
+    // splitting full parents on the way; the nodes above keep their ranking,
+    // as they still hold the same keys.
+    void split(uint32_t leaf, const std::vector<Step>& path) {
+        auto right = static_cast<uint32_t>(leaves_.size());
+        leaves_.emplace_back();
+        Leaf& l = leaves_[leaf];
+        Leaf& r = leaves_[right];
+        uint32_t half = l.count / 2;
+        std::copy(l.keys + half, l.keys + l.count, r.keys);
+        r.count = l.count - half;
+        l.count = half;
+        rankLeaf(leaf);
+        rankLeaf(right);
+
+        Key sep = r.keys[0];
+        uint32_t child = right;
+        for (size_t i = path.size(); i-- > 0;) {
+            Inner* n = &inner_[path[i].node];
+            uint32_t at = path[i].pos + 1;
+            std::copy_backward(n->child + at, n->child + n->count, n->child + n->count + 1);
+            std::copy_backward(n->sep + at, n->sep + n->count, n->sep + n->count + 1);
+            std::copy_backward(n->sepHead + at, n->sepHead + n->count, n->sepHead + n->count + 1);
+            n->child[at] = child;
+            n->sep[at] = sep;
+            n->sepHead[at] = head(sep, 0);
+            if (++n->count < kFanout) return;
+
+            child = static_cast<uint32_t>(inner_.size());
+            inner_.emplace_back();
+            n = &inner_[path[i].node];
+            Inner& m = inner_[child];
+            uint32_t keep = n->count / 2;
+            m.level = n->level;
+            m.count = n->count - keep;
+            std::copy(n->child + keep, n->child + n->count, m.child);
+            std::copy(n->sep + keep, n->sep + n->count, m.sep);
+            std::copy(n->sepHead + keep, n->sepHead + n->count, m.sepHead);
+            n->count = keep;
+            sep = m.sep[0];
+            rankInner(path[i].node);
+            rankInner(child);
+        }
+        auto root = static_cast<uint32_t>(inner_.size());
+        inner_.emplace_back();
+        Inner& n = inner_[root];
+        n.level = ++height_;
+        n.count = 2;
+        n.child[0] = root_;
+        n.child[1] = child;
+        n.sep[1] = sep;
+        n.sepHead[1] = head(sep, 0);
+        root_ = root;
+        rankInner(root);
+    }
+
+    // Brings the rankings up to date with the weight changes since refresh().
+    // A removed entry's keys leave their leaves first. Then each node above a
+    // changed entry's keys is re-ranked, children first: wholly if it ranked
+    // an entry that went down, which may now have to give way; else the
+    // entries that went up leave its ranking and every changed entry is
+    // offered to it again.
+    void rerank() {
+        if (raised_.empty() && lowered_.empty()) return;
+        struct Mark {
+            uint32_t level, node, entry;
+            bool lowered;
+            bool operator<(const Mark& o) const {
+                return level != o.level ? level < o.level : node != o.node ? node < o.node : entry != o.entry ? entry < o.entry : lowered < o.lowered;
+            }
+            bool operator==(const Mark& o) const { return level == o.level && node == o.node && entry == o.entry && lowered == o.lowered; }
+        };
+        std::vector<Mark> marks;
+        std::vector<Step> path;
+        auto less = [this](const Key& a, const Key& b) { return keyLess(a, b); };
+        auto mark = [&](const std::vector<uint32_t>& changed, bool lowered) {
+            for (uint32_t e : changed) {
+                for (uint32_t start : starts(e)) {
+                    Key k{e, start};
+                    uint32_t leaf = descend(k, path);
+                    if (entries_[e].weight == 0) {
+                        Leaf& l = leaves_[leaf];
+                        Key* at = std::lower_bound(l.keys, l.keys + l.count, k, less);
+                        if (at != l.keys + l.count && at->entry == e && at->start == start) {
+                            std::copy(at + 1, l.keys + l.count, at);
+                            --l.count;
+                            --treeKeys_;
+                        }
+                    }
+                    marks.push_back(Mark{0, leaf, e, lowered});
+                    for (const Step& s : path) marks.push_back(Mark{inner_[s.node].level, s.node, e, lowered});
+                }
+            }
+        };
+        // An entry that went both ways counts as lowered.
+        std::sort(lowered_.begin(), lowered_.end());
+        lowered_.erase(std::unique(lowered_.begin(), lowered_.end()), lowered_.end());
+        std::sort(raised_.begin(), raised_.end());
+        raised_.erase(std::unique(raised_.begin(), raised_.end()), raised_.end());
+        raised_.erase(std::remove_if(raised_.begin(), raised_.end(),
+                                     [this](uint32_t e) { return std::binary_search(lowered_.begin(), lowered_.end(), e); }),
+                      raised_.end());
+        mark(lowered_, true);
+        mark(raised_, false);
+        raised_.clear();
+        lowered_.clear();
+
+        std::sort(marks.begin(), marks.end());
+        marks.erase(std::unique(marks.begin(), marks.end()), marks.end());
+        for (size_t i = 0, j; i < marks.size(); i = j) {
+            for (j = i + 1; j < marks.size() && marks[j].level == marks[i].level && marks[j].node == marks[i].node;) ++j;
+            Top& t = marks[i].level == 0 ? leaves_[marks[i].node].top : inner_[marks[i].node].top;
+            auto ranks = [&t](uint32_t e) { return std::find(t.ids, t.ids + t.count, e) != t.ids + t.count; };
+            bool rankedLowered = false;
+            for (size_t m = i; m < j && !rankedLowered; ++m) rankedLowered = marks[m].lowered && ranks(marks[m].entry);
+            if (rankedLowered) {
+                if (marks[i].level == 0) rankLeaf(marks[i].node);
+                else rankInner(marks[i].node);
+                continue;
+            }
+            uint8_t kept = 0;
+            for (uint8_t n = 0; n < t.count; ++n) {
+                bool raised = false;
+                for (size_t m = i; m < j && !raised; ++m) raised = !marks[m].lowered && marks[m].entry == t.ids[n];
+                if (!raised) t.ids[kept++] = t.ids[n];
+            }
+            t.count = kept;
+            for (size_t m = i; m < j; ++m) offer(t, marks[m].entry);
+        }
+    }
+
+    // Rebuilds the tree from its live keys and the pending ones, compacting
+    // the entries once a quarter of them are removed.
+    void rebuild() {
+        std::vector<Key> keys;
+        keys.reserve(treeKeys_ + pending_.size());
+        if (!inner_.empty()) flatten(root_, height_, keys);
+        sortKeys(pending_.begin(), pending_.end());
+        // The pending keys are usually much the fewer: find each one's place and copy the runs between.
+        std::vector<Key> merged;
+        merged.reserve(keys.size() + pending_.size());
+        auto less = [this](const Key& a, const Key& b) { return keyLess(a, b); };
+        auto at = keys.begin();
+        for (const Key& k : pending_) {
+            auto to = std::upper_bound(at, keys.end(), k, less);
+            merged.insert(merged.end(), at, to);
+            merged.push_back(k);
+            at = to;
+        }
+        merged.insert(merged.end(), at, keys.end());
+        std::vector<Key>().swap(keys);
+        std::vector<Key>().swap(pending_);
+        raised_.clear();
+        lowered_.clear();
+        if (deadEntries_ * 4 > entries_.size()) compact(merged);
+        treeKeys_ = merged.size();
+        treeEntries_ = static_cast<uint32_t>(entries_.size());
+
+        leaves_.clear();
+        inner_.clear();
+        std::vector<uint32_t> level;
+        std::vector<Key> firsts;
+        for (size_t i = 0; i < merged.size() || leaves_.empty(); i += kLeafFill) {
+            auto leaf = static_cast<uint32_t>(leaves_.size());
+            leaves_.emplace_back();
+            Leaf& l = leaves_.back();
+            l.count = static_cast<uint32_t>(std::min(kLeafFill, merged.size() - i));
+            std::copy(merged.begin() + static_cast<std::ptrdiff_t>(i), merged.begin() + static_cast<std::ptrdiff_t>(i + l.count), l.keys);
+            rankLeaf(leaf);
+            level.push_back(leaf);
+            firsts.push_back(l.count ? l.keys[0] : Key{});
+        }
+        height_ = 0;
+        do {
+            ++height_;
+            std::vector<uint32_t> up;
+            std::vector<Key> upFirsts;
+            for (size_t i = 0; i < level.size(); i += kFanoutFill) {
+                auto node = static_cast<uint32_t>(inner_.size());
+                inner_.emplace_back();
+                Inner& n = inner_.back();
+                n.level = height_;
+                n.count = static_cast<uint32_t>(std::min(kFanoutFill, level.size() - i));
+                std::copy(level.begin() + static_cast<std::ptrdiff_t>(i), level.begin() + static_cast<std::ptrdiff_t>(i + n.count), n.child);
+                std::copy(firsts.begin() + static_cast<std::ptrdiff_t>(i), firsts.begin() + static_cast<std::ptrdiff_t>(i + n.count), n.sep);
+                for (uint32_t c = 1; c < n.count; ++c) n.sepHead[c] = head(n.sep[c], 0);
+                rankInner(node);
+                up.push_back(node);
+                upFirsts.push_back(firsts[i]);
+            }
+            level = std::move(up);
+            firsts = std::move(upFirsts);
+        } while (level.size() > 1);
+        root_ = level[0];
+    }
+
+    // Appends the live keys under node in order.
+    void flatten(uint32_t node, uint32_t level, std::vector<Key>& out) const {
+        if (level == 0) {
+            const Leaf& l = leaves_[node];
+            for (size_t i = 0; i < l.count; ++i)
+                if (entries_[l.keys[i].entry].weight > 0) out.push_back(l.keys[i]);
+            return;
+        }
+        const Inner& n = inner_[node];
+        for (size_t i = 0; i < n.count; ++i) flatten(n.child[i], level - 1, out);
+    }
+
+    // Drops removed entries, keeping the others in order so keys stays sorted.
+    void compact(std::vector<Key>& keys) {
+        std::vector<uint32_t> renumber(entries_.size(), kNone);
+        std::vector<Entry> entries;
+        std::string text;
+        entries.reserve(entries_.size() - deadEntries_);
+        for (uint32_t e = 0; e < entries_.size(); ++e) {
+            const Entry& en = entries_[e];
+            if (en.weight == 0) continue;
+            renumber[e] = static_cast<uint32_t>(entries.size());
+            entries.push_back(Entry{static_cast<uint32_t>(text.size()), en.length, en.weight, en.kind});
+            text.append(text_, en.offset, en.length);
+        }
+        for (Key& k : keys) k.entry = renumber[k.entry];
+        entries_ = std::move(entries);
+        text_ = std::move(text);
+        deadEntries_ = 0;
+        rehash(entries_.size());
+    }
+
+    // --- (kind, text) -> entry
+    size_t slotOf(Kind kind, std::string_view text) const {
+        return (std::hash<std::string_view>{}(text) * 31 + kind) & (table_.size() - 1);
+    }
+
+    uint32_t find(Kind kind, const std::string& text) const {
+        if (table_.empty()) return kNone;
+        for (size_t s = slotOf(kind, text);; s = (s + 1) & (table_.size() - 1)) {
+            uint32_t e = table_[s];
+            if (e == kNone) return kNone;
+            if (e != kErased && entries_[e].kind == kind &&
+                std::string_view(text_.data() + entries_[e].offset, entries_[e].length) == text)
+                return e;
+        }
+    }
+
+    void insertId(uint32_t e) {
+        if ((tableUsed_ + 1) * 2 > table_.size()) {
+            rehash(entries_.size() - deadEntries_);  // takes e along with the others
+            return;
+        }
+        const Entry& en = entries_[e];
+        size_t s = slotOf(en.kind, std::string_view(text_.data() + en.offset, en.length));
+        while (table_[s] != kNone) s = (s + 1) & (table_.size() - 1);
+        table_[s] = e;
+        ++tableUsed_;
+    }
+
+    void eraseId(uint32_t e) {
+        const Entry& en = entries_[e];
+        size_t s = slotOf(en.kind, std::string_view(text_.data() + en.offset, en.length));
+        while (table_[s] != e) s = (s + 1) & (table_.size() - 1);
+        table_[s] = kErased;
+    }
+
+    // Resizes the table for live entries and drops its tombstones.
+    void rehash(size_t live) {
+        size_t size = 16;
+        while (size < 4 * live) size *= 2;
+        table_.assign(size, kNone);
+        tableUsed_ = 0;
+        for (uint32_t e = 0; e < entries_.size(); ++e) {
+            if (entries_[e].weight == 0) continue;
+            const Entry& en = entries_[e];
+            size_t s = slotOf(en.kind, std::string_view(text_.data() + en.offset, en.length));
+            while (table_[s] != kNone) s = (s + 1) & (table_.size() - 1);
+            table_[s] = e;
+            ++tableUsed_;
+        }
+    }
+};
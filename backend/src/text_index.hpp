@@ -0,0 +1,354 @@
+#pragma once
+#include "fuzzy.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Splits text into lowercase tokens on anything that is not an ASCII letter
+// or digit. Bytes >= 0x80 are kept, so UTF-8 words stay whole.
+inline std::vector<std::string> tokenize(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::string cur;
+    for (unsigned char c : text) {
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+            cur += static_cast<char>(c);
+        } else if (c >= 'A' && c <= 'Z') {
+            cur += static_cast<char>(c - 'A' + 'a');
+        } else if (!cur.empty()) {
+            tokens.push_back(std::move(cur));
+            cur.clear();
+        }
+    }
+    if (!cur.empty()) tokens.push_back(std::move(cur));
+    return tokens;
+}
+
+// Inverted index over book titles and authors. Each token maps to a posting
+// list sorted by book id; queries AND their terms by intersecting the lists,
+// shortest first, and rank the matches by idf-weighted term frequency with
+// title hits counting double.
+class TextIndex {
+public:
+    struct Hit {
+        int id;
+        double score;
+    };
+
+    void add(int id, const std::string& title, const std::string& author) {
+        for (const auto& p : collect(title, author)) {
+            auto& list = postings_[p.first];
+            if (list.empty()) vocabulary_.insert(p.first);
+            Posting entry{id, p.second.titleCount, p.second.authorCount};
+            if (list.empty() || list.back().id < id) {
+                list.push_back(entry);
+            } else {
+                auto it = std::lower_bound(list.begin(), list.end(), id, byId);
+                if (it != list.end() && it->id == id) *it = entry;
+                else list.insert(it, entry);
+            }
+        }
+        ++docs_;
+    }
+
+    // Must be given the same title and author the book was added with.
+    void remove(int id, const std::string& title, const std::string& author) {
+        for (const auto& p : collect(title, author)) {
+            auto found = postings_.find(p.first);
+            if (found == postings_.end()) continue;
+            auto& list = found->second;
+            auto it = std::lower_bound(list.begin(), list.end(), id, byId);
+            if (it != list.end() && it->id == id) list.erase(it);
+            if (list.empty()) {
+                vocabulary_.erase(p.first);
+                postings_.erase(found);
+            }
+        }
+        if (docs_) --docs_;
+    }
+
+    // Books containing every query token, best k first. total receives the
+    // number of matches before the cut.
+    std::vector<Hit> search(const std::string& query, size_t k, size_t& total) const {
+        total = 0;
+        std::vector<const std::vector<Posting>*> lists;
+        if (!termLists(query, lists)) return {};
+
+        // Candidates start as the rarest list; each further list filters them.
+        std::vector<Hit> hits;
+        hits.reserve(lists[0]->size());
+        double idf0 = idf(lists[0]->size());
+        for (const auto& p : *lists[0]) hits.push_back({p.id, idf0 * weight(p)});
+
+        for (size_t l = 1; l < lists.size() && !hits.empty(); ++l) {
+            const auto& list = *lists[l];
+            double w = idf(list.size());
+            size_t kept = 0;
+            auto from = list.begin();
+            for (const auto& h : hits) {
+                from = gallop(from, list.end(), h.id);
+                if (from == list.end()) break;
+                if (from->id == h.id) hits[kept++] = {h.id, h.score + w * weight(*from)};
+            }
+            hits.resize(kept);
+        }
+
+        total = hits.size();
+        return best(std::move(hits), k);
+    }
+
+    // Ids of the books search() matches, in id order, neither scored nor
+    // ranked: for callers that count or filter the matches rather than page
+    // through them.
+    std::vector<int> match(const std::string& query) const {
+        std::vector<const std::vector<Posting>*> lists;
+        if (!termLists(query, lists)) return {};
+        std::vector<int> ids;
+        ids.reserve(lists[0]->size());
+        for (const auto& p : *lists[0]) ids.push_back(p.id);
+        for (size_t l = 1; l < lists.size() && !ids.empty(); ++l) {
+            size_t kept = 0;
+            auto from = lists[l]->begin();
+            for (int id : ids) {
+                from = gallop(from, lists[l]->end(), id);
+                if (from == lists[l]->end()) break;
+                if (from->id == id) ids[kept++] = id;
+            }
+            ids.resize(kept);
+        }
+        return ids;
+    }
+
+    // Like search(), but each query word also matches indexed words within
+    // one edit (two for words of eight or more bytes; exact only below four),
+    // found through the vocabulary index. Matches score less per edit.
+    // The rarest word's matches are walked in id order and each book is
+    // checked against the other words' matches, so every book is a real match
+    // as soon as it is found. If deadline passes, complete is set to false and
+    // the books found by then are ranked; total counts only those.
+    std::vector<Hit> searchFuzzy(const std::string& query, size_t k, size_t& total,
+                                 std::chrono::steady_clock::time_point deadline, bool& complete) const {
+        total = 0;
+        std::vector<Hit> top;  // heap with the worst kept hit at the front
+        complete = forEachFuzzy(query, deadline, [&](int id, double score) {
+            ++total;
+            Hit hit{id, score};
+            if (top.size() < k) {
+                top.push_back(hit);
+                std::push_heap(top.begin(), top.end(), better);
+            } else if (!top.empty() && better(hit, top.front())) {
+                std::pop_heap(top.begin(), top.end(), better);
+                top.back() = hit;
+                std::push_heap(top.begin(), top.end(), better);
+            }
+        });
+        std::sort_heap(top.begin(), top.end(), better);
+        return top;
+    }
+
+    // Ids of the books searchFuzzy() matches, in id order, neither ranked nor
+    // cut; deadline and complete work as there.
+    std::vector<int> matchFuzzy(const std::string& query, std::chrono::steady_clock::time_point deadline,
+                                bool& complete) const {
+        std::vector<int> ids;
+        complete = forEachFuzzy(query, deadline, [&](int id, double) { ids.push_back(id); });
+        return ids;
+    }
+
+private:
+    struct Posting {
+        int id;
+        uint16_t titleCount;
+        uint16_t authorCount;
+    };
+
+    struct Counts {
+        uint16_t titleCount = 0;
+        uint16_t authorCount = 0;
+    };
+
+    using Iter = std::vector<Posting>::const_iterator;
+
+    // An indexed word a fuzzy query word expands to: its posting list from
+    // the current position on, and the score weight of its matches.
+    struct Cursor {
+        Iter at;
+        Iter end;
+        double w;
+    };
+
+    struct Expansions {
+        std::vector<Cursor> cursors;
+        size_t postings = 0;
+    };
+
+    // Indexed words a fuzzy query word may expand to, nearest first. Past the
+    // first, a word is skipped if its postings would take the total over
+    // kMaxExpansionPostings: a typo near several very common words must not
+    // make every book a candidate, while one near many rare words (a book
+    // number) keeps them all.
+    static constexpr size_t kMaxExpansions = 128;
+    static constexpr size_t kMaxExpansionPostings = size_t(1) << 18;
+
+    std::unordered_map<std::string, std::vector<Posting>> postings_;
+    TrigramIndex vocabulary_;  // every token that has a posting list
+    size_t docs_ = 0;
+
+    static bool better(const Hit& a, const Hit& b) { return a.score != b.score ? a.score > b.score : a.id < b.id; }
+
+    static std::vector<Hit> best(std::vector<Hit> hits, size_t k) {
+        if (hits.size() > k) {
+            std::partial_sort(hits.begin(), hits.begin() + k, hits.end(), better);
+            hits.resize(k);
+        } else {
+            std::sort(hits.begin(), hits.end(), better);
+        }
+        return hits;
+    }
+
+    // The query's distinct tokens, sorted.
+    static std::vector<std::string> terms(const std::string& query) {
+        std::vector<std::string> terms = tokenize(query);
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+        return terms;
+    }
+
+    // The posting lists of the query's terms, shortest first. Returns false
+    // if the query has no terms or one of them is not indexed.
+    bool termLists(const std::string& query, std::vector<const std::vector<Posting>*>& lists) const {
+        std::vector<std::string> words = terms(query);
+        if (words.empty()) return false;
+        for (const auto& t : words) {
+            auto found = postings_.find(t);
+            if (found == postings_.end()) return false;
+            lists.push_back(&found->second);
+        }
+        std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+        return true;
+    }
+
+    // The indexed words term stands for, rarest first within each distance,
+    // as cursors at the start of their lists. Returns false if deadline passed
+    // during the lookup; out then holds the words found so far.
+    bool expand(const std::string& term, std::chrono::steady_clock::time_point deadline, Expansions& out) const {
+        std::vector<TrigramIndex::Match> matches;
+        bool onTime = true;
+        int maxDist = term.size() < 4 ? 0 : term.size() < 8 ? 1 : 2;
+        if (maxDist == 0 || term.size() > 64) {
+            auto found = postings_.find(term);
+            if (found != postings_.end()) matches.push_back({&found->first, 0});
+        } else {
+            onTime = vocabulary_.match(term, maxDist, kMaxExpansions, deadline, matches);
+        }
+
+        std::vector<std::pair<int, const std::vector<Posting>*>> lists;
+        for (const auto& m : matches) lists.push_back({m.distance, &postings_.at(*m.token)});
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first < b.first : a.second->size() < b.second->size();
+        });
+        for (const auto& l : lists) {
+            const auto& list = *l.second;
+            if (!out.cursors.empty() && out.postings + list.size() > kMaxExpansionPostings) continue;
+            out.cursors.push_back({list.begin(), list.end(), idf(list.size()) / (1.0 + l.first)});
+            out.postings += list.size();
+        }
+        return onTime;
+    }
+
+    // Calls found(id, score) for each book matching every query word or a
+    // near spelling of it, in id order. The word with the fewest postings
+    // leads: its lists are merged, and each book they give is looked up in
+    // the other words' lists, whose cursors only move forward. A book's score
+    // sums, per word, its best expansion's. Returns false if deadline passed
+    // before every book was found.
+    template <typename Found>
+    bool forEachFuzzy(const std::string& query, std::chrono::steady_clock::time_point deadline, Found found) const {
+        std::vector<std::string> words = terms(query);
+        if (words.empty()) return true;
+        std::vector<Expansions> expanded(words.size());
+        bool onTime = true;
+        for (size_t t = 0; t < words.size(); ++t) {
+            onTime = expand(words[t], deadline, expanded[t]) && onTime;
+            if (expanded[t].cursors.empty()) return onTime;
+        }
+        std::sort(expanded.begin(), expanded.end(),
+                  [](const Expansions& a, const Expansions& b) { return a.postings < b.postings; });
+
+        // Reports a book of the leading word if every other word has it too.
+        auto check = [&](int id, double score) {
+            for (size_t t = 1; t < expanded.size(); ++t) {
+                double best = -1;
+                for (Cursor& c : expanded[t].cursors) {
+                    c.at = gallop(c.at, c.end, id);
+                    if (c.at != c.end && c.at->id == id) best = std::max(best, c.w * weight(*c.at));
+                }
+                if (best < 0) return;
+                score += best;
+            }
+            found(id, score);
+        };
+
+        std::vector<Cursor>& lead = expanded[0].cursors;
+        auto later = [](const Cursor& a, const Cursor& b) { return a.at->id > b.at->id; };
+        std::make_heap(lead.begin(), lead.end(), later);
+        size_t steps = 0;
+        while (!lead.empty()) {
+            if ((++steps & 63) == 0 && std::chrono::steady_clock::now() > deadline) return false;
+            if (lead.size() == 1) {
+                Cursor& c = lead[0];
+                check(c.at->id, c.w * weight(*c.at));
+                if (++c.at == c.end) lead.pop_back();
+                continue;
+            }
+            int id = lead.front().at->id;
+            double score = 0;
+            while (!lead.empty() && lead.front().at->id == id) {
+                std::pop_heap(lead.begin(), lead.end(), later);
+                Cursor& c = lead.back();
+                score = std::max(score, c.w * weight(*c.at));
+                if (++c.at == c.end) lead.pop_back();
+                else std::push_heap(lead.begin(), lead.end(), later);
+            }
+            check(id, score);
+        }
+        return onTime;
+    }
+
+    static bool byId(const Posting& p, int id) { return p.id < id; }
+
+    static double weight(const Posting& p) { return 2.0 * p.titleCount + p.authorCount; }
+
+    double idf(size_t df) const { return std::log(1.0 + double(docs_) / double(df)); }
+
+    static std::unordered_map<std::string, Counts> collect(const std::string& title, const std::string& author) {
+        std::unordered_map<std::string, Counts> counts;
+        for (auto& t : tokenize(title)) {
+            auto& c = counts[std::move(t)];
+            if (c.titleCount < UINT16_MAX) ++c.titleCount;
+        }
+        for (auto& t : tokenize(author)) {
+            auto& c = counts[std::move(t)];
+            if (c.authorCount < UINT16_MAX) ++c.authorCount;
+        }
+        return counts;
+    }
+
+    // First position >= id, probing 1, 2, 4, ... ahead before a binary search,
+    // so intersecting a short list with a long one stays near O(short * log gap).
+    static Iter gallop(Iter from, Iter end, int id) {
+        size_t step = 1;
+        Iter lo = from;
+        while (lo != end && lo->id < id) {
+            size_t left = static_cast<size_t>(end - lo);
+            Iter probe = lo + std::min(step, left - 1);
+            if (probe->id >= id) return std::lower_bound(lo, probe + 1, id, byId);
+            lo = probe + 1;
+            step <<= 1;
+        }
+        return lo;
+    }
+};
@@ -0,0 +1,256 @@
+#pragma once
+#include "models.hpp"
+#include "persistence.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One pending change to library.db.
+struct Mutation {
+    enum Kind { SaveBook, SaveUser, DeleteBook, SetAvailability, SaveLoan, DeleteLoan };
+
+    Kind kind;
+    Book book{};
+    User user{};
+    Loan loan{};
+    int id = 0;
+    bool available = true;
+
+    static Mutation saveBook(const Book& b) { Mutation m{SaveBook}; m.book = b; return m; }
+    static Mutation saveUser(const User& u) { Mutation m{SaveUser}; m.user = u; return m; }
+    static Mutation deleteBook(int id) { Mutation m{DeleteBook}; m.id = id; return m; }
+    static Mutation setAvailability(int id, bool available) {
+        Mutation m{SetAvailability};
+        m.id = id;
+        m.available = available;
+        return m;
+    }
+    static Mutation saveLoan(const Loan& l) { Mutation m{SaveLoan}; m.loan = l; return m; }
+    static Mutation deleteLoan(int bookId) { Mutation m{DeleteLoan}; m.id = bookId; return m; }
+
+    // For logs: the kind and the row it touches, e.g. "saveBook 42".
+    std::string describe() const {
+        switch (kind) {
+            case SaveBook: return "saveBook " + std::to_string(book.id);
+            case SaveUser: return "saveUser " + std::to_string(user.userId);
+            case DeleteBook: return "deleteBook " + std::to_string(id);
+            case SetAvailability: return "setAvailability " + std::to_string(id) + (available ? " true" : " false");
+            case SaveLoan: return "saveLoan " + std::to_string(loan.bookId);
+            case DeleteLoan: return "deleteLoan " + std::to_string(id);
+        }
+        return "unknown";
+    }
+};
+
+// Write-behind queue in front of Persistence. A background thread drains
+// mutations in arrival order and commits them in batches of up to
+// maxBatch, waiting at most maxDelay for a batch to fill, so concurrent
+// writers share one transaction (and one fsync) instead of paying for one each.
+class WriteQueue {
+public:
+    struct Options {
+        size_t maxBatch = 512;
+        std::chrono::microseconds maxDelay{2000};
+        // Called on the writer thread for every mutation that did not reach
+        // library.db, whether or not anyone waits on it.
+        std::function<void(const Mutation&)> onFailed;
+    };
+
+    WriteQueue(Persistence& store, Options options) : store_(store), options_(options) {}
+    WriteQueue(const WriteQueue&) = delete;
+    WriteQueue& operator=(const WriteQueue&) = delete;
+    ~WriteQueue() { stop(); }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (worker_.joinable()) return;
+        stopping_ = false;
+        worker_ = std::thread([this] { run(); });
+    }
+
+    // Commits everything still queued, then joins the writer thread.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    // Ack-after-enqueue: returns as soon as the mutation is queued.
+    void enqueue(Mutation m) { push(Pending{single(std::move(m)), nullptr}); }
+
+    // Ack-after-commit: the future resolves once the mutation's batch has
+    // committed, with false if the statement or the commit failed.
+    std::future<bool> enqueueAndWait(Mutation m) { return enqueueGroupAndWait(single(std::move(m))); }
+
+    // Queues mutations that must land in the same transaction. A group is
+    // never split across batches, even if it is larger than maxBatch.
+    void enqueueGroup(std::vector<Mutation> group) { push(Pending{std::move(group), nullptr}); }
+
+    std::future<bool> enqueueGroupAndWait(std::vector<Mutation> group) {
+        auto done = std::make_shared<std::promise<bool>>();
+        std::future<bool> result = done->get_future();
+        push(Pending{std::move(group), std::move(done)});
+        return result;
+    }
+
+    // Blocks until everything queued so far has been committed. Only valid
+    // while the writer thread is running.
+    void flush() { enqueueGroupAndWait({}).wait(); }
+
+    // Mutations that failed to commit since start.
+    uint64_t failed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failed_;
+    }
+
+    json stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return json{
+            {"queueDepth", queuedMutations_},
+            {"batches", batches_},
+            {"mutations", mutations_},
+            {"failed", failed_},
+            {"avgBatchSize", batches_ ? double(mutations_) / batches_ : 0.0},
+            {"maxBatchSize", maxBatchSeen_},
+            {"lastCommitUs", lastCommitUs_},
+            {"avgCommitUs", batches_ ? totalCommitUs_ / batches_ : 0},
+            {"maxCommitUs", maxCommitUs_},
+        };
+    }
+
+private:
+    struct Pending {
+        std::vector<Mutation> group;
+        std::shared_ptr<std::promise<bool>> done;
+    };
+
+    Persistence& store_;
+    Options options_;
+    std::thread worker_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Pending> queue_;
+    size_t queuedMutations_ = 0;
+    bool stopping_ = false;
+
+    uint64_t batches_ = 0;
+    uint64_t mutations_ = 0;
+    uint64_t failed_ = 0;
+    size_t maxBatchSeen_ = 0;
+    uint64_t lastCommitUs_ = 0;
+    uint64_t totalCommitUs_ = 0;
+    uint64_t maxCommitUs_ = 0;
+
+    static std::vector<Mutation> single(Mutation m) {
+        std::vector<Mutation> group;
+        group.push_back(std::move(m));
+        return group;
+    }
+
+    void push(Pending p) {
+        bool notify;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bool wasEmpty = queue_.empty();
+            queuedMutations_ += p.group.size();
+            queue_.push_back(std::move(p));
+            notify = wasEmpty || queuedMutations_ >= options_.maxBatch;
+        }
+        if (notify) wake_.notify_one();
+    }
+
+    bool apply(const Mutation& m) {
+        switch (m.kind) {
+            case Mutation::SaveBook: return store_.saveBook(m.book);
+            case Mutation::SaveUser: return store_.saveUser(m.user);
+            case Mutation::DeleteBook: return store_.deleteBook(m.id);
+            case Mutation::SetAvailability: return store_.setBookAvailability(m.id, m.available);
+            case Mutation::SaveLoan: return store_.saveLoan(m.loan);
+            case Mutation::DeleteLoan: return store_.deleteLoan(m.id);
+        }
+        return false;
+    }
+
+    // All or nothing: a group of several mutations runs inside a savepoint
+    // and is rolled back to it at the first failure, leaving the rest of the
+    // batch to commit. A single statement is atomic on its own.
+    bool applyGroup(const std::vector<Mutation>& group) {
+        if (group.size() == 1) return apply(group.front());
+        if (group.empty()) return true;
+        if (!store_.savepoint()) return false;
+        for (const Mutation& m : group) {
+            if (!apply(m)) {
+                store_.rollbackToSavepoint();
+                return false;
+            }
+        }
+        return store_.releaseSavepoint();
+    }
+
+    void run() {
+        std::vector<Pending> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;  // stopping with nothing left
+
+            // Give a partial batch up to maxDelay to fill before committing.
+            auto deadline = std::chrono::steady_clock::now() + options_.maxDelay;
+            wake_.wait_until(lock, deadline, [this] { return stopping_ || queuedMutations_ >= options_.maxBatch; });
+
+            // Whole groups only; the first one is always taken.
+            size_t taken = 0;
+            batch.clear();
+            while (!queue_.empty() && (batch.empty() || taken + queue_.front().group.size() <= options_.maxBatch)) {
+                taken += queue_.front().group.size();
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            queuedMutations_ -= taken;
+            lock.unlock();
+
+            auto started = std::chrono::steady_clock::now();
+            std::vector<bool> groupOk(batch.size(), false);
+            uint64_t failedInBatch = 0;
+            bool committed = false;
+            if (store_.begin()) {
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    groupOk[i] = applyGroup(batch[i].group);
+                    if (!groupOk[i]) failedInBatch += batch[i].group.size();
+                }
+                if (taken && !store_.bumpGeneration()) ++failedInBatch;
+                committed = store_.commit();
+                if (!committed) store_.rollback();
+            }
+            if (!committed) failedInBatch = taken;
+            auto elapsedUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started).count());
+
+            for (size_t i = 0; i < batch.size(); ++i) {
+                bool ok = committed && groupOk[i];
+                if (!ok && options_.onFailed)
+                    for (const Mutation& m : batch[i].group) options_.onFailed(m);
+                if (batch[i].done) batch[i].done->set_value(ok);
+            }
+
+            lock.lock();
+            ++batches_;
+            mutations_ += taken;
+            failed_ += failedInBatch;
+            maxBatchSeen_ = std::max(maxBatchSeen_, taken);
+            lastCommitUs_ = elapsedUs;
+            totalCommitUs_ += elapsedUs;
+            maxCommitUs_ = std::max(maxCommitUs_, elapsedUs);
+        }
+    }
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <pthread.h>
+
+// A shared mutex that lets a waiting writer in before newly arriving readers.
+// std::shared_mutex on glibc prefers readers, so a steady stream of
+// overlapping readers can keep a writer waiting indefinitely; here, once a
+// writer queues, new readers queue behind it. The price is that a thread
+// must not take the lock shared twice: a writer queued between the two
+// would deadlock it.
+//
+// Meets the SharedMutex requirements, for std::shared_lock / std::unique_lock.
+class WriterPriorityMutex {
+public:
+    WriterPriorityMutex() {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+        pthread_rwlock_init(&lock_, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    }
+    ~WriterPriorityMutex() { pthread_rwlock_destroy(&lock_); }
+
+    WriterPriorityMutex(const WriterPriorityMutex&) = delete;
+    WriterPriorityMutex& operator=(const WriterPriorityMutex&) = delete;
+
+    void lock() { pthread_rwlock_wrlock(&lock_); }
+    bool try_lock() { return pthread_rwlock_trywrlock(&lock_) == 0; }
+    void unlock() { pthread_rwlock_unlock(&lock_); }
+
+    void lock_shared() { pthread_rwlock_rdlock(&lock_); }
+    bool try_lock_shared() { return pthread_rwlock_tryrdlock(&lock_) == 0; }
+    void unlock_shared() { pthread_rwlock_unlock(&lock_); }
+
+private:
+    pthread_rwlock_t lock_;
+};
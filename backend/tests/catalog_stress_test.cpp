@@ -0,0 +1,160 @@
+// N reader threads against M writer threads on the catalog, its indexes and
+// the GET /books body cache, locked the way main.cpp locks them: writers
+// change books through BookMutations holding data_mutex exclusively, readers
+// share it or pin a copy through BooksBodyCache. Readers check every body and listing they see
+// is one consistent catalog. Best run under -fsanitize=thread.
+//
+// usage: catalog_stress_test [readers] [writers] [changes per writer]
+#include "book_mutations.hpp"
+#include "books_cache.hpp"
+#include "writer_priority_mutex.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Catalog books;
+IdIndex bookIndex;
+BookOrderIndexes bookOrder(books);
+TextIndex searchIndex;
+SuggestIndex suggestIndex;
+ScanEngine scanEngine;
+WriterPriorityMutex data_mutex;
+std::atomic<uint64_t> catalogVersion{0};
+BookMutations bookMutations(books, bookIndex, bookOrder, searchIndex, suggestIndex, scanEngine, catalogVersion);
+BooksBodyCache booksBody;
+
+std::atomic<size_t> failures{0};
+std::atomic<bool> writing{true};
+
+void fail(const std::string& what) {
+    if (failures++ < 10) std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+}
+
+// Titles and authors are derived from the id, so any book a reader sees can
+// be checked on its own.
+std::string titleFor(int id, unsigned edition) { return "Title " + std::to_string(id) + " #" + std::to_string(edition); }
+std::string authorFor(int id) { return "Author " + std::to_string(id % 37); }
+
+bool plausible(int id, std::string_view title, std::string_view author) {
+    std::string prefix = "Title " + std::to_string(id) + " #";
+    return title.compare(0, prefix.size(), prefix) == 0 && author == authorFor(id);
+}
+
+void upsert(const Book& b) {
+    std::unique_lock<WriterPriorityMutex> lock(data_mutex);
+    bookMutations.upsert(b);
+    suggestIndex.refresh();
+}
+
+void removeBook(int id) {
+    std::unique_lock<WriterPriorityMutex> lock(data_mutex);
+    bookMutations.remove(id);
+    suggestIndex.refresh();
+}
+
+void flip(int id) {
+    std::unique_lock<WriterPriorityMutex> lock(data_mutex);
+    size_t slot = bookIndex.find(id);
+    if (slot != IdIndex::npos) bookMutations.setAvailable(slot, !books.isAvailable(slot));
+}
+
+void writer(unsigned seed, size_t changes) {
+    std::mt19937 rng(seed);
+    for (size_t n = 0; n < changes; ++n) {
+        int id = static_cast<int>(rng() % 2000);
+        unsigned op = rng() % 10;
+        if (op < 5) upsert(Book{id, titleFor(id, rng() % 100), authorFor(id), rng() % 2 == 0});
+        else if (op < 8) removeBook(id);
+        else flip(id);
+    }
+}
+
+// Whole bodies: valid JSON, unique ids, every book consistent.
+void checkBody() {
+    BooksBodyCache::Body body = booksBody.current(books, data_mutex, catalogVersion);
+    json parsed = json::parse(*body.json, nullptr, false);
+    if (parsed.is_discarded() || !parsed.contains("books")) return fail("body is not JSON");
+    std::set<int> ids;
+    for (const auto& b : parsed["books"]) {
+        int id = b["id"].get<int>();
+        if (!ids.insert(id).second) fail("id " + std::to_string(id) + " twice in a body");
+        if (!plausible(id, b["title"].get<std::string>(), b["author"].get<std::string>()))
+            fail("torn book " + std::to_string(id) + " in a body");
+    }
+}
+
+// Under the shared lock: every order is sorted, on the right availability
+// side and agrees with the id index.
+void checkIndexes(std::mt19937& rng) {
+    std::shared_lock<WriterPriorityMutex> lock(data_mutex);
+    size_t listed = 0;
+    for (const auto* side : {&bookOrder.available, &bookOrder.issued}) {
+        bool isAvailable = side == &bookOrder.available;
+        listed += side->byId.size();
+        for (auto it = side->byTitle.begin(); it != side->byTitle.end(); ++it) {
+            if (books.isAvailable(*it) != isAvailable) fail("book on the wrong availability side");
+            if (it != side->byTitle.begin() && !side->byTitle.key_comp()(*std::prev(it), *it)) fail("byTitle out of order");
+        }
+        if (side->byAuthor.size() != side->byId.size() || side->byAuthorTitle.size() != side->byId.size())
+            fail("orders disagree on size");
+    }
+    if (listed != books.size()) fail("orders miss books");
+    for (int n = 0; n < 50; ++n) {
+        int id = static_cast<int>(rng() % 2000);
+        size_t slot = bookIndex.find(id);
+        size_t total;
+        std::string word = std::to_string(id);
+        auto hits = searchIndex.search("title " + word, SIZE_MAX, total);
+        bool found = std::any_of(hits.begin(), hits.end(), [id](const TextIndex::Hit& h) { return h.id == id; });
+        auto scanned = scanEngine.scan(books, "title " + word + " #", ScanEngine::Title, SIZE_MAX, total);
+        bool inScan = std::find(scanned.begin(), scanned.end(), id) != scanned.end();
+        if (found != (slot != IdIndex::npos) || inScan != found) fail("search indexes disagree with the catalog on " + word);
+        if (slot == IdIndex::npos) continue;
+        if (books.id(slot) != id || !plausible(id, books.title(slot), books.author(slot))) fail("id index points at the wrong book");
+    }
+}
+
+void reader(unsigned seed) {
+    std::mt19937 rng(seed);
+    do {
+        checkBody();
+        checkIndexes(rng);
+    } while (writing);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t readers = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4;
+    size_t writers = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2;
+    size_t changes = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 20000;
+
+    std::vector<std::thread> readerThreads, writerThreads;
+    for (size_t r = 0; r < readers; ++r) readerThreads.emplace_back(reader, static_cast<unsigned>(100 + r));
+    for (size_t w = 0; w < writers; ++w) writerThreads.emplace_back(writer, static_cast<unsigned>(w + 1), changes);
+    for (auto& t : writerThreads) t.join();
+    writing = false;
+    for (auto& t : readerThreads) t.join();
+
+    std::mt19937 rng(0);
+    checkBody();
+    checkIndexes(rng);
+    if (failures) {
+        std::fprintf(stderr, "%zu failures\n", failures.load());
+        return 1;
+    }
+    std::printf("ok: %zu readers, %zu writers x %zu changes, %zu books left\n", readers, writers, changes, books.size());
+    return 0;
+}